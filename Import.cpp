@@ -42,8 +42,7 @@ namespace import_tidy {
     return SM->getModuleImportLoc(Loc).second;
   }
 
-  static FileID
-  topFileIncludingFile(FileID File, const SourceManager &SM) {
+  FileID topFileIncludingFile(FileID File, const SourceManager &SM) {
     if (!SM.isInSystemHeader(SM.getLocForStartOfFile(File)))
       return File;
 
@@ -74,7 +73,9 @@ namespace import_tidy {
   }
 
   static ImportType calculateType(FileID File, const SourceManager &SM) {
-    if (SM.isLoadedFileID(File))
+    // files loaded from a precompiled header are not in a module
+    if (SM.isLoadedFileID(File) &&
+        !moduleName(SM.getLocForStartOfFile(File), &SM).empty())
       return ImportType::Module;
     else if (SM.isInSystemHeader(SM.getLocForStartOfFile(File)))
       return ImportType::Library;
@@ -127,20 +128,9 @@ namespace import_tidy {
         OS << "@import " << Import.getName() << ";";
         break;
 
-      case ImportType::Library: {
-        OS << "#import <";
-
-        auto Path = Import.getName();
-        if (isFramework(Path))
-          OS << frameworkName(Path) << "/" << filename(Path);
-        else if (isSystemLibrary(Path))
-          OS << strippedLibraryPath(Path);
-        else
-          OS << twoLevelPath(Path);
-
-        OS << ">";
+      case ImportType::Library:
+        OS << "#import <" << libraryIncludeName(Import.getName()) << ">";
         break;
-      }
 
       case ImportType::File:
         OS << "#import \"" << Import.getName() << "\"";
@@ -157,9 +147,9 @@ namespace import_tidy {
     return OS;
   }
 
-  const std::set<FileID>
+  const DenseSet<FileID>
   getSuperclasses(const std::vector<Import> &Imports, const SourceManager &SM) {
-    std::set<FileID> Superclasses;
+    DenseSet<FileID> Superclasses;
 
     for (auto &I : Imports) {
       if (I.getType() != ImportType::File)
@@ -168,7 +158,9 @@ namespace import_tidy {
       if (auto *ID = dyn_cast<ObjCInterfaceDecl>(I.getDecl())) {
         auto *Superclass = ID->getSuperClass();
         while (Superclass && !SM.isInSystemHeader(Superclass->getLocation())) {
-          Superclasses.insert(SM.getFileID(Superclass->getLocation()));
+          auto FID = SM.getFileID(Superclass->getLocation());
+          if (FID.isValid())
+            Superclasses.insert(FID);
           Superclass = Superclass->getSuperClass();
         }
       }
@@ -179,18 +171,19 @@ namespace import_tidy {
   const std::vector<const Import*>
   sortedUniqueImports(const SourceManager &SM,
                       const std::vector<Import> &Imports,
-                      const std::set<FileID> &Excluding) {
+                      const DenseSet<FileID> &Excluding) {
     // get the set of superclass files to avoid unnecessary imports
     auto Superclasses = getSuperclasses(Imports, SM);
 
     // get the set of imported files so we can remove unneeded forward declares
-    std::set<FileID> ImportedFiles;
+    DenseSet<FileID> ImportedFiles;
     for (auto &I : Imports) {
       if (!I.isForwardDeclare())
         ImportedFiles.insert(I.getFile());
     }    
 
     std::vector<const Import*> SortedImports;
+    SortedImports.reserve(Imports.size());
     for (auto &I : Imports) {
       auto FID = I.getFile();
 
@@ -221,4 +214,24 @@ namespace import_tidy {
   clang::SourceLocation getDeclLoc(const Decl *D) {
     return D->getLocation().isFileID() ? D->getLocation() : D->getLocStart();
   }
+
+  std::string libraryIncludeName(StringRef Path) {
+    if (isFramework(Path))
+      return (frameworkName(Path) + "/" + filename(Path)).str();
+    else if (isSystemLibrary(Path))
+      return strippedLibraryPath(Path);
+    else
+      return twoLevelPath(Path);
+  }
+
+  StringRef umbrellaFramework(StringRef Path) {
+    if (!isFramework(Path))
+      return StringRef();
+
+    auto Framework = frameworkName(Path);
+    auto File = filename(Path);
+    if (!File.endswith(".h") || File.drop_back(2) != Framework)
+      return StringRef();
+    return Framework;
+  }
 }
@@ -5,7 +5,8 @@
 #include "llvm/Support/raw_ostream.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/AST/Decl.h"
-#include <set>
+#include "llvm/ADT/DenseSet.h"
+#include <vector>
 
 namespace import_tidy {
   enum class ImportType {
@@ -32,20 +33,41 @@ namespace import_tidy {
       return Type == ImportType::ForwardDeclareClass ||
              Type == ImportType::ForwardDeclareProtocol;
     };
+    void setModule(llvm::StringRef Module) {
+      LibraryName = Name;
+      Type = ImportType::Module;
+      Name = Module;
+    }
+    // the header a module import stands for, for units without modules
+    llvm::StringRef getLibraryName() const { return LibraryName; }
 
   private:
     const clang::Decl *ImportedDecl;
     clang::FileID File;
     llvm::StringRef Name;
+    llvm::StringRef LibraryName;
     ImportType Type;
   };
 
   llvm::raw_ostream& operator<<(llvm::raw_ostream&, const Import&);
+  const llvm::DenseSet<clang::FileID>
+  getSuperclasses(const std::vector<Import>&, const clang::SourceManager&);
   const std::vector<const Import*>
   sortedUniqueImports(const clang::SourceManager&,
                       const std::vector<Import> &Imports,
-                      const std::set<clang::FileID> &Excluding);
+                      const llvm::DenseSet<clang::FileID> &Excluding);
   clang::SourceLocation getDeclLoc(const clang::Decl*);
+
+  // the outermost header of the same directory that includes a system
+  // File, File itself otherwise
+  clang::FileID topFileIncludingFile(clang::FileID, const clang::SourceManager&);
+
+  // how a library header at Path is imported, X/Y.h for a framework header
+  std::string libraryIncludeName(llvm::StringRef Path);
+
+  // the framework X if Path is its umbrella header X.framework/Headers/X.h,
+  // otherwise empty
+  llvm::StringRef umbrellaFramework(llvm::StringRef Path);
 }
 
 #endif /* defined(__LLVM__Import__) */
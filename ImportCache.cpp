@@ -0,0 +1,192 @@
+#include "ImportCache.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+using namespace llvm;
+using namespace clang::tooling;
+
+namespace {
+
+  // bump whenever the output of the tool changes for the same input
+  static const uint64_t kCacheVersion = 6;
+  static const char kCacheMagic[] = "import-tidy-cache";
+
+  static std::string md5String(StringRef Data) {
+    MD5 Hash;
+    Hash.update(Data);
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    SmallString<32> Str;
+    MD5::stringifyResult(Result, Str);
+    return Str.str();
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - HeaderCache
+
+  std::shared_ptr<const HeaderCache::Entry> HeaderCache::lookup(StringRef Key) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    auto Found = Entries.find(Key);
+    if (Found == Entries.end()) {
+      Misses++;
+      return nullptr;
+    }
+    Hits++;
+    return Found->second;
+  }
+
+  void HeaderCache::insert(StringRef Key, std::shared_ptr<const Entry> E) {
+    // units racing on the same key computed the same entry
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Entries.insert(std::make_pair(Key, std::move(E)));
+  }
+
+  void HeaderCache::clear() {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Entries.clear();
+    Hits = 0;
+    Misses = 0;
+  }
+
+  void HeaderCache::printStats(raw_ostream &OS) const {
+    unsigned Total = Hits + Misses;
+    OS << "Header cache: " << Hits << " hits, " << Misses << " misses";
+    if (Total > 0)
+      OS << " (" << (uint64_t(Hits) * 100 / Total) << "% hit rate)";
+    OS << "\n";
+  }
+
+#pragma mark - ResultCache
+
+  std::string ResultCache::key(StringRef File, ArrayRef<CompileCommand> Commands,
+                               StringRef Options) {
+    std::string Key;
+    raw_string_ostream OS(Key);
+    OS << kCacheVersion << '\0' << Options << '\0' << File << '\0';
+    for (auto &Command : Commands) {
+      OS << Command.Directory << '\0';
+      for (auto &Arg : Command.CommandLine)
+        OS << Arg << '\0';
+    }
+    return md5String(OS.str());
+  }
+
+  std::string ResultCache::entryPath(StringRef Key) const {
+    SmallString<256> Path(Directory);
+    sys::path::append(Path, Key);
+    return Path.str();
+  }
+
+  std::string ResultCache::contentHash(StringRef Path) {
+    {
+      std::lock_guard<std::mutex> Lock(HashMutex);
+      auto Found = ContentHashes.find(Path);
+      if (Found != ContentHashes.end())
+        return Found->second;
+    }
+
+    // hash outside the lock, the same file hashes the same on any thread
+    std::string Hash;
+    auto Buffer = MemoryBuffer::getFile(Path);
+    if (Buffer)
+      Hash = md5String((*Buffer)->getBuffer());
+
+    std::lock_guard<std::mutex> Lock(HashMutex);
+    ContentHashes[Path] = Hash;
+    return Hash;
+  }
+
+  void ResultCache::clearContentHashes() {
+    // files can change between runs of a long lived runner
+    std::lock_guard<std::mutex> Lock(HashMutex);
+    ContentHashes.clear();
+  }
+
+  bool ResultCache::lookup(StringRef Key, TUResult &Result) {
+    auto Buffer = MemoryBuffer::getFile(entryPath(Key));
+    if (!Buffer) {
+      Misses++;
+      return false;
+    }
+
+    StringRef Data = (*Buffer)->getBuffer();
+    std::string Magic;
+    uint64_t Version, Count;
+    std::vector<std::string> Hashes;
+    if (!readString(Data, Magic) || Magic != kCacheMagic ||
+        !readNumber(Data, Version) || Version != kCacheVersion ||
+        !readNumber(Data, Count)) {
+      Misses++;
+      return false;
+    }
+
+    Hashes.resize(Count);
+    for (auto &Hash : Hashes) {
+      if (!readString(Data, Hash)) {
+        Misses++;
+        return false;
+      }
+    }
+
+    // the result is only valid if nothing it depends on has changed
+    TUResult Cached;
+    if (!readResult(Data, Cached) || Cached.Dependencies.size() != Hashes.size()) {
+      Misses++;
+      return false;
+    }
+    for (size_t I = 0; I < Hashes.size(); I++) {
+      if (contentHash(Cached.Dependencies[I]) != Hashes[I]) {
+        Misses++;
+        return false;
+      }
+    }
+
+    Result = std::move(Cached);
+    Hits++;
+    return true;
+  }
+
+  void ResultCache::store(StringRef Key, const TUResult &Result) {
+    if (sys::fs::create_directories(Directory))
+      return;
+
+    int FD;
+    SmallString<256> TempPath;
+    if (sys::fs::createUniqueFile(entryPath(Key) + "-%%%%%%.tmp", FD, TempPath))
+      return;
+
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      writeString(OS, kCacheMagic);
+      writeNumber(OS, kCacheVersion);
+      writeNumber(OS, Result.Dependencies.size());
+      for (auto &Path : Result.Dependencies)
+        writeString(OS, contentHash(Path));
+      writeResult(OS, Result);
+      OS.close();
+      if (OS.has_error()) {
+        OS.clear_error();
+        sys::fs::remove(TempPath.str());
+        return;
+      }
+    }
+
+    // rename so concurrent runs never see a partial entry
+    if (sys::fs::rename(TempPath.str(), entryPath(Key)))
+      sys::fs::remove(TempPath.str());
+  }
+
+  void ResultCache::printStats(raw_ostream &OS) const {
+    unsigned Total = Hits + Misses;
+    OS << "Result cache: " << Hits << " hits, " << Misses << " misses";
+    if (Total > 0)
+      OS << " (" << (uint64_t(Hits) * 100 / Total) << "% hit rate)";
+    OS << "\n";
+  }
+
+} // end namespace import_tidy
@@ -0,0 +1,71 @@
+#ifndef __LLVM__ImportCache__
+#define __LLVM__ImportCache__
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include "ImportResult.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // Remembers how each header was tidied during a run, keyed by its path,
+  // its content and what a translation unit needed in it. A later unit
+  // with the same key reuses the block, replacements and merge input
+  // instead of sorting and formatting them again. The key includes the
+  // unit's requirements, so every unit still adds its own to the merge.
+  class HeaderCache {
+  public:
+    HeaderCache() : Hits(0), Misses(0) {};
+
+    struct Entry {
+      FileImports File;
+
+      // what the header adds to the library and file counts of a unit
+      std::vector<std::string> Libraries;
+      std::vector<std::string> Files;
+    };
+    std::shared_ptr<const Entry> lookup(llvm::StringRef Key);
+    void insert(llvm::StringRef Key, std::shared_ptr<const Entry>);
+    void clear();
+    void printStats(llvm::raw_ostream&) const;
+  private:
+    std::mutex Mutex;
+    llvm::StringMap<std::shared_ptr<const Entry>> Entries;
+    std::atomic<unsigned> Hits;
+    std::atomic<unsigned> Misses;
+  };
+
+  // Persists each translation unit's result between runs, keyed on its
+  // compile commands and validated against the content of every file it
+  // included, so unchanged translation units never reach clang.
+  class ResultCache {
+  public:
+    ResultCache(llvm::StringRef Directory) :
+      Directory(Directory), Hits(0), Misses(0) {};
+
+    static std::string
+    key(llvm::StringRef File,
+        llvm::ArrayRef<clang::tooling::CompileCommand> Commands,
+        llvm::StringRef Options);
+    bool lookup(llvm::StringRef Key, TUResult&);
+    void store(llvm::StringRef Key, const TUResult&);
+    std::string contentHash(llvm::StringRef Path);
+    void clearContentHashes();
+    void printStats(llvm::raw_ostream&) const;
+  private:
+    std::string entryPath(llvm::StringRef Key) const;
+    std::string Directory;
+    std::mutex HashMutex;
+    llvm::StringMap<std::string> ContentHashes;
+    std::atomic<unsigned> Hits;
+    std::atomic<unsigned> Misses;
+  };
+}
+
+#endif /* defined(__LLVM__ImportCache__) */
@@ -27,6 +27,22 @@ namespace {
       if (!SM.isInSystemHeader(HashLoc)) {
         Matcher.removeImport(HashLoc, SM);
       }
+
+      // any included file can change the result of this translation unit
+      if (File) {
+        Matcher.addDependency(File->getName(), SM);
+        Matcher.addInclude(SM.getFileID(HashLoc), File);
+      }
+    }
+
+    void FileChanged(SourceLocation Loc,
+                     FileChangeReason Reason,
+                     SrcMgr::CharacteristicKind FileType,
+                     FileID PrevFID) override {
+      // only declarations from these files are ever traversed
+      if (Reason == EnterFile && FileType == SrcMgr::C_User) {
+        Matcher.addProjectFile(SM.getFileID(Loc));
+      }
     }
 
   private:
@@ -37,166 +53,206 @@ namespace {
 
 namespace import_tidy {
   bool FileCallbacks::handleBeginSource(CompilerInstance &CI, StringRef Filename) {
-    llvm::outs() << "Compiling " << Filename << "\n";
+    llvm::raw_string_ostream(Matcher.getLog()) << "Compiling " << Filename << "\n";
     auto &SM = CI.getSourceManager();
     auto &PP = CI.getPreprocessor();
     PP.addPPCallbacks(std::unique_ptr<ImportCallbacks>(new ImportCallbacks(SM, Matcher)));
     SourceMgr = &SM;
     Matcher.setSysroot(CI.getHeaderSearchOpts().Sysroot);
 
+    // the consumer then decides which bodies to skip
+    if (Matcher.getOptions().SkipHeaderBodies)
+      CI.getFrontendOpts().SkipFunctionBodies = true;
+
     return true;
   }
 
   void FileCallbacks::handleEndSource() {
+    if (Matcher.getOptions().MicroBenchIterations)
+      Matcher.benchmark(*SourceMgr);
     Matcher.flush(*SourceMgr);
   }
 
-  void CallExprCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *FD = Result.Nodes.getNodeAs<CallExpr>(nodeKey)->getDirectCallee()) {
-      auto &SM = *Result.SourceManager;
+#pragma mark - Match callbacks
+
+#define IMPORTCALLBACK_RUN(NAME, NODE) \
+  void NAME::run(const MatchFinder::MatchResult &Result) { \
+    if (auto *Node = Result.Nodes.getNodeAs<NODE>(nodeKey)) \
+      handle(Node, *Result.SourceManager); \
+  }
+
+  IMPORTCALLBACK_RUN(CallExprCallback, CallExpr)
+  IMPORTCALLBACK_RUN(CastExprCallback, CStyleCastExpr)
+  IMPORTCALLBACK_RUN(CategoryCallback, ObjCCategoryDecl)
+  IMPORTCALLBACK_RUN(DeclRefCallback, DeclRefExpr)
+  IMPORTCALLBACK_RUN(FuncDeclCallback, FunctionDecl)
+  IMPORTCALLBACK_RUN(InterfaceCallback, ObjCInterfaceDecl)
+  IMPORTCALLBACK_RUN(MessageExprCallback, ObjCMessageExpr)
+  IMPORTCALLBACK_RUN(MethodCallback, ObjCMethodDecl)
+  IMPORTCALLBACK_RUN(StripCallback, Decl)
+
+  void ProtocolCallback::run(const MatchFinder::MatchResult &Result) {
+    auto &SM = *Result.SourceManager;
+
+    if (auto *PE = Result.Nodes.getNodeAs<ObjCProtocolExpr>(nodeKey)) {
+      handle(PE, SM);
+    } else if (auto *PD = Result.Nodes.getNodeAs<ObjCProtocolDecl>(nodeKey)) {
+      handle(PD, SM);
+    }
+  }
+
+#pragma mark - ImportCallback
+
+  ImportCallback::CountMatch::CountMatch(ImportCallback &Callback) :
+  Callback(Callback), Timed(Callback.Matcher.getOptions().CollectStats) {
+    Callback.Matches++;
+    if (Timed)
+      Start = std::chrono::steady_clock::now();
+  }
+
+  ImportCallback::CountMatch::~CountMatch() {
+    if (Timed) {
+      std::chrono::duration<double, std::micro> Elapsed =
+        std::chrono::steady_clock::now() - Start;
+      Callback.Time += Elapsed.count();
+    }
+  }
+
+#pragma mark - Handlers
+
+  void CallExprCallback::handle(const CallExpr *CE, const SourceManager &SM) {
+    CountMatch Count(*this);
+    if (auto *FD = CE->getDirectCallee()) {
       if (SM.isInMainFile(FD->getLocStart())) {
         Matcher.addImport(SM.getMainFileID(), FD, SM);
       }
     }
   }
 
-  void CastExprCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *CE = Result.Nodes.getNodeAs<CStyleCastExpr>(nodeKey)) {
-      auto &SM = *Result.SourceManager;
-      Matcher.addType(SM.getMainFileID(), CE->getType(), SM);
-    }
+  void CastExprCallback::handle(const CStyleCastExpr *CE, const SourceManager &SM) {
+    CountMatch Count(*this);
+    Matcher.addType(SM.getMainFileID(), CE->getType(), SM);
   }
 
-  void CategoryCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *CD = Result.Nodes.getNodeAs<ObjCCategoryDecl>(nodeKey)) {
-      auto &SM = *Result.SourceManager;
-      auto InFile = SM.getFileID(CD->getLocation());
+  void CategoryCallback::handle(const ObjCCategoryDecl *CD, const SourceManager &SM) {
+    CountMatch Count(*this);
+    auto InFile = SM.getFileID(CD->getLocation());
 
-      // import categorized class
-      Matcher.addImport(InFile, CD->getClassInterface(), SM);
+    // import categorized class
+    Matcher.addImport(InFile, CD->getClassInterface(), SM);
 
-      // import this file, it is a header
-      if (InFile != SM.getMainFileID()) {
-        Matcher.addHeaderFile(InFile);
-        Matcher.addImport(SM.getMainFileID(), CD, SM);
-      }
+    // import this file, it is a header
+    if (InFile != SM.getMainFileID()) {
+      Matcher.addHeaderFile(InFile);
+      Matcher.addImport(SM.getMainFileID(), CD, SM);
     }
   }
 
-  void DeclRefCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *DRE = Result.Nodes.getNodeAs<DeclRefExpr>(nodeKey)) {
-      auto &SM = *Result.SourceManager;
-      auto InFile = SM.getFileID(DRE->getLocation());
+  void DeclRefCallback::handle(const DeclRefExpr *DRE, const SourceManager &SM) {
+    CountMatch Count(*this);
+    auto InFile = SM.getFileID(DRE->getLocation());
 
-      // some Decls are located in the main file but have an external type (eg ParmVarDecl)
-      // some Decls are located externally but have an already imported type (eg Global constants)
-      Matcher.addImport(InFile, DRE->getDecl(), SM);
-      Matcher.addType(InFile, DRE->getType(), SM);
-    }
+    // some Decls are located in the main file but have an external type (eg ParmVarDecl)
+    // some Decls are located externally but have an already imported type (eg Global constants)
+    Matcher.addImport(InFile, DRE->getDecl(), SM);
+    Matcher.addType(InFile, DRE->getType(), SM);
   }
 
-  void FuncDeclCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *FD = Result.Nodes.getNodeAs<FunctionDecl>(nodeKey)) {
-      // treat files with function prototypes as headers
-      for (auto *RD : FD->redecls()) {
-        if (RD != FD && RD->isExternC())
-          Matcher.addHeaderFile(Result.SourceManager->getFileID(RD->getLocation()));
-      }
+  void FuncDeclCallback::handle(const FunctionDecl *FD, const SourceManager &SM) {
+    CountMatch Count(*this);
+    // treat files with function prototypes as headers
+    for (auto *RD : FD->redecls()) {
+      if (RD != FD && RD->isExternC())
+        Matcher.addHeaderFile(SM.getFileID(RD->getLocation()));
     }
   }
 
-  void InterfaceCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *ID = Result.Nodes.getNodeAs<ObjCInterfaceDecl>(nodeKey)) {
-      auto &SM = *Result.SourceManager;
-      auto InFile = SM.getFileID(ID->getLocation());
+  void InterfaceCallback::handle(const ObjCInterfaceDecl *ID, const SourceManager &SM) {
+    CountMatch Count(*this);
+    auto InFile = SM.getFileID(ID->getLocation());
 
-      // import superclasses
-      if (auto *SC = ID->getSuperClass()) {
-        Matcher.addImport(InFile, SC, SM);
-      }
+    // import superclasses
+    if (auto *SC = ID->getSuperClass()) {
+      Matcher.addImport(InFile, SC, SM);
+    }
 
-      // import this file, it is a header
-      if (InFile != SM.getMainFileID()) {
-        Matcher.addHeaderFile(InFile);
-        Matcher.addImport(SM.getMainFileID(), ID, SM);
-      }
+    // import this file, it is a header
+    if (InFile != SM.getMainFileID()) {
+      Matcher.addHeaderFile(InFile);
+      Matcher.addImport(SM.getMainFileID(), ID, SM);
+    }
 
-      // import all protocol definitions
-      for (auto *P : ID->protocols()) {
-        Matcher.addImport(InFile, P, SM);
-      }
+    // import all protocol definitions
+    for (auto *P : ID->protocols()) {
+      Matcher.addImport(InFile, P, SM);
+    }
 
-      // import all protocol definitions of categories, most likely
-      // class extensions in the implementation
-      for (auto *Category : ID->visible_categories()) {
-        auto CategoryFile = SM.getFileID(Category->getLocation());
+    // import all protocol definitions of categories, most likely
+    // class extensions in the implementation
+    for (auto *Category : ID->visible_categories()) {
+      auto CategoryFile = SM.getFileID(Category->getLocation());
 
-        for (auto *Protocol : Category->protocols()) {
-          Matcher.addImport(CategoryFile, Protocol, SM);
-        }
+      for (auto *Protocol : Category->protocols()) {
+        Matcher.addImport(CategoryFile, Protocol, SM);
       }
+    }
 
-      // import any categories extending this class or its superclasses
-      // that were included from this file
-      auto *D = ID;
-      do {
-        for (auto *Cat : D->visible_categories()) {
-          for (auto *Ctx : Cat->noload_decls()) {
-            auto Loc = Ctx->getLocStart();
-            auto IncludedIn = SM.getFileID(SM.getIncludeLoc(SM.getFileID(Loc)));
-            if (IncludedIn == InFile) {
-              Matcher.addImport(InFile, Ctx, SM);
-            }
+    // import any categories extending this class or its superclasses
+    // that were included from this file
+    auto *D = ID;
+    do {
+      for (auto *Cat : D->visible_categories()) {
+        for (auto *Ctx : Cat->noload_decls()) {
+          auto Loc = Ctx->getLocStart();
+          auto IncludedIn = SM.getFileID(SM.getIncludeLoc(SM.getFileID(Loc)));
+          if (IncludedIn == InFile) {
+            Matcher.addImport(InFile, Ctx, SM);
           }
         }
-      } while ((D = D->getSuperClass()));
-    }
+      }
+    } while ((D = D->getSuperClass()));
   }
 
-  void MessageExprCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *E = Result.Nodes.getNodeAs<ObjCMessageExpr>(nodeKey)) {
-      auto &SM = *Result.SourceManager;
-      Matcher.addImport(SM.getMainFileID(), E->getMethodDecl(), SM);
-      Matcher.addType(SM.getMainFileID(), E->getType(), SM);
+  void MessageExprCallback::handle(const ObjCMessageExpr *E, const SourceManager &SM) {
+    CountMatch Count(*this);
+    Matcher.addImport(SM.getMainFileID(), E->getMethodDecl(), SM);
+    Matcher.addType(SM.getMainFileID(), E->getType(), SM);
 
-      if (auto *ID = E->getReceiverInterface()) {
-        Matcher.addImport(SM.getMainFileID(), ID, SM);
-      } else {
-        Matcher.addType(SM.getMainFileID(), E->getReceiverType(), SM);
-      }
+    if (auto *ID = E->getReceiverInterface()) {
+      Matcher.addImport(SM.getMainFileID(), ID, SM);
+    } else {
+      Matcher.addType(SM.getMainFileID(), E->getReceiverType(), SM);
     }
   }
 
-  void MethodCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *M = Result.Nodes.getNodeAs<ObjCMethodDecl>(nodeKey)) {
-      auto FID = Result.SourceManager->getFileID(M->getLocation());
-      Matcher.addType(FID, M->getReturnType(), *Result.SourceManager);
+  void MethodCallback::handle(const ObjCMethodDecl *M, const SourceManager &SM) {
+    CountMatch Count(*this);
+    auto FID = SM.getFileID(M->getLocation());
+    Matcher.addType(FID, M->getReturnType(), SM);
 
-      for (auto i = M->param_begin(); i != M->param_end(); i++) {
-        Matcher.addType(FID, (*i)->getType(), *Result.SourceManager);
-      }
+    for (auto i = M->param_begin(); i != M->param_end(); i++) {
+      Matcher.addType(FID, (*i)->getType(), SM);
     }
   }
 
-  void ProtocolCallback::run(const MatchFinder::MatchResult &Result) {
-    auto &SM = *Result.SourceManager;
+  void ProtocolCallback::handle(const ObjCProtocolExpr *PE, const SourceManager &SM) {
+    CountMatch Count(*this);
+    Matcher.addImport(SM.getMainFileID(), PE->getProtocol(), SM);
+  }
 
-    if (auto *PE = Result.Nodes.getNodeAs<ObjCProtocolExpr>(nodeKey)) {
-      Matcher.addImport(SM.getMainFileID(), PE->getProtocol(), SM);
-    } else if (auto *PD = Result.Nodes.getNodeAs<ObjCProtocolDecl>(nodeKey)) {
-      if (PD->isThisDeclarationADefinition()) {
-        for (auto *P : PD->protocols()) {
-          Matcher.addImport(SM.getFileID(PD->getLocStart()), P, SM);
-        }
+  void ProtocolCallback::handle(const ObjCProtocolDecl *PD, const SourceManager &SM) {
+    CountMatch Count(*this);
+    if (PD->isThisDeclarationADefinition()) {
+      for (auto *P : PD->protocols()) {
+        Matcher.addImport(SM.getFileID(PD->getLocStart()), P, SM);
       }
     }
   }
 
-  void StripCallback::run(const MatchFinder::MatchResult &Result) {
-    if (auto *D = Result.Nodes.getNodeAs<Decl>(nodeKey)) {
-      // implicit imports will already be stripped by the preprocessor callbacks
-      if (!D->isImplicit())
-        Matcher.removeImport(D->getLocStart(), *Result.SourceManager);
-    }
+  void StripCallback::handle(const Decl *D, const SourceManager &SM) {
+    CountMatch Count(*this);
+    // implicit imports will already be stripped by the preprocessor callbacks
+    if (!D->isImplicit())
+      Matcher.removeImport(D->getLocStart(), SM);
   }
 }
@@ -1,9 +1,12 @@
 #ifndef __LLVM__ImportCallbacks__
 #define __LLVM__ImportCallbacks__
 
+#include "clang/AST/DeclObjC.h"
+#include "clang/AST/ExprObjC.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Tooling/Tooling.h"
+#include <chrono>
 
 namespace import_tidy {
   class ImportMatcher;
@@ -19,25 +22,60 @@ namespace import_tidy {
     const clang::SourceManager *SourceMgr;
   };
 
-#define IMPORTCALLBACK(NAME) \
-  class NAME : public clang::ast_matchers::MatchFinder::MatchCallback { \
+  // Counts the nodes a callback handles, and when stats are collected
+  // how long it spent handling them.
+  class ImportCallback : public clang::ast_matchers::MatchFinder::MatchCallback {
+  public:
+    ImportCallback(ImportMatcher &Matcher) : Matcher(Matcher), Matches(0), Time(0) { };
+    virtual const char *getName() const = 0;
+    unsigned getMatches() const { return Matches; }
+    double getTime() const { return Time; }
+    void resetStats() { Matches = 0; Time = 0; }
+  protected:
+    // counts one node for the lifetime of the handler
+    class CountMatch {
+    public:
+      CountMatch(ImportCallback&);
+      ~CountMatch();
+    private:
+      ImportCallback &Callback;
+      bool Timed;
+      std::chrono::steady_clock::time_point Start;
+    };
+    ImportMatcher &Matcher;
+  private:
+    unsigned Matches;
+    double Time;
+  };
+
+#define IMPORTCALLBACK(NAME, NODE) \
+  class NAME : public ImportCallback { \
   public: \
-    NAME(ImportMatcher &Matcher) : Matcher(Matcher) { }; \
+    NAME(ImportMatcher &Matcher) : ImportCallback(Matcher) { }; \
+    const char *getName() const override { return #NAME; } \
     void run(const clang::ast_matchers::MatchFinder::MatchResult&) override; \
-  private: \
-    ImportMatcher &Matcher; \
+    void handle(const clang::NODE*, const clang::SourceManager&); \
   };
 
-  IMPORTCALLBACK(CallExprCallback)
-  IMPORTCALLBACK(CastExprCallback)
-  IMPORTCALLBACK(CategoryCallback)
-  IMPORTCALLBACK(DeclRefCallback)
-  IMPORTCALLBACK(FuncDeclCallback)
-  IMPORTCALLBACK(InterfaceCallback)
-  IMPORTCALLBACK(MessageExprCallback)
-  IMPORTCALLBACK(MethodCallback)
-  IMPORTCALLBACK(ProtocolCallback)
-  IMPORTCALLBACK(StripCallback)
+  IMPORTCALLBACK(CallExprCallback, CallExpr)
+  IMPORTCALLBACK(CastExprCallback, CStyleCastExpr)
+  IMPORTCALLBACK(CategoryCallback, ObjCCategoryDecl)
+  IMPORTCALLBACK(DeclRefCallback, DeclRefExpr)
+  IMPORTCALLBACK(FuncDeclCallback, FunctionDecl)
+  IMPORTCALLBACK(InterfaceCallback, ObjCInterfaceDecl)
+  IMPORTCALLBACK(MessageExprCallback, ObjCMessageExpr)
+  IMPORTCALLBACK(MethodCallback, ObjCMethodDecl)
+  IMPORTCALLBACK(StripCallback, Decl)
+
+  // matches both protocol expressions and declarations
+  class ProtocolCallback : public ImportCallback {
+  public:
+    ProtocolCallback(ImportMatcher &Matcher) : ImportCallback(Matcher) { };
+    const char *getName() const override { return "ProtocolCallback"; }
+    void run(const clang::ast_matchers::MatchFinder::MatchResult&) override;
+    void handle(const clang::ObjCProtocolExpr*, const clang::SourceManager&);
+    void handle(const clang::ObjCProtocolDecl*, const clang::SourceManager&);
+  };
 }
 
 #endif /* defined(__LLVM__ImportCallbacks__) */
@@ -0,0 +1,257 @@
+#include "ImportFileSystem.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+  // a file handed out by the cache, only opened for real when its
+  // contents aren't cached yet
+  class CachedFile : public vfs::File {
+  public:
+    CachedFile(import_tidy::CachingFileSystem &FS, StringRef Path,
+               std::unique_ptr<vfs::File> Opened) :
+      FS(FS), Path(Path), Opened(std::move(Opened)) {};
+
+    ErrorOr<vfs::Status> status() override {
+      return FS.status(Path);
+    }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>>
+    getBuffer(const Twine &Name, int64_t FileSize,
+              bool RequiresNullTerminator, bool IsVolatile) override {
+      return FS.getBuffer(Path, Opened.get(), Name, FileSize,
+                          RequiresNullTerminator, IsVolatile);
+    }
+
+    std::error_code close() override {
+      return Opened ? Opened->close() : std::error_code();
+    }
+
+    void setName(StringRef Name) override {
+      if (Opened)
+        Opened->setName(Name);
+    }
+
+  private:
+    import_tidy::CachingFileSystem &FS;
+    std::string Path;
+    std::unique_ptr<vfs::File> Opened;
+  };
+
+  static bool sameStatus(const vfs::Status &L, const vfs::Status &R) {
+    return L.getType() == R.getType() && L.getSize() == R.getSize() &&
+           L.getLastModificationTime() == R.getLastModificationTime();
+  }
+
+  static unsigned percentSaved(unsigned Calls, unsigned Saved) {
+    return Calls + Saved > 0 ? uint64_t(Saved) * 100 / (Calls + Saved) : 0;
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - CachingFileSystem
+
+  void CachingFileSystem::addUncachedDirectory(StringRef Directory) {
+    if (std::find(UncachedDirectories.begin(), UncachedDirectories.end(),
+                  Directory) == UncachedDirectories.end())
+      UncachedDirectories.push_back(Directory);
+  }
+
+  void CachingFileSystem::addStableDirectory(StringRef Directory) {
+    // every translation unit adds its sysroot while others are running
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (std::find(StableDirectories.begin(), StableDirectories.end(),
+                  Directory) == StableDirectories.end())
+      StableDirectories.push_back(Directory);
+  }
+
+  bool CachingFileSystem::isUncached(StringRef Path) const {
+    for (auto &Directory : UncachedDirectories) {
+      if (Path.startswith(Directory))
+        return true;
+    }
+    return false;
+  }
+
+  bool CachingFileSystem::isStable(StringRef Path) const {
+    for (auto &Directory : StableDirectories) {
+      if (Path.startswith(Directory))
+        return true;
+    }
+    return false;
+  }
+
+  void CachingFileSystem::revalidate() {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    // a project file that was edited, created or removed is fetched again,
+    // a missing file that is still missing stays a saved stat
+    std::vector<std::string> Changed;
+    for (auto &Entry : Statuses) {
+      auto Path = Entry.getKey();
+      if (isStable(Path))
+        continue;
+
+      auto &Cached = Entry.getValue();
+      auto Status = Underlying->status(Path);
+      bool Same = Status ? !Cached.Error && sameStatus(*Status, Cached.Status)
+                         : Cached.Error == Status.getError();
+      if (!Same)
+        Changed.push_back(Path);
+    }
+    for (auto &Entry : Buffers) {
+      auto Path = Entry.getKey();
+      if (!isStable(Path) && !Statuses.count(Path))
+        Changed.push_back(Path);
+    }
+    for (auto &Path : Changed) {
+      Statuses.erase(Path);
+      Buffers.erase(Path);
+    }
+
+    // the stats are printed for every run
+    Stats = 0;
+    SavedStats = 0;
+    Opens = 0;
+    SavedOpens = 0;
+    Reads = 0;
+    SavedReads = 0;
+  }
+
+  bool CachingFileSystem::lookupStatus(StringRef Path, StatEntry &Entry) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    auto Found = Statuses.find(Path);
+    if (Found == Statuses.end())
+      return false;
+    Entry = Found->second;
+    return true;
+  }
+
+  void CachingFileSystem::insertStatus(StringRef Path,
+                                       const ErrorOr<vfs::Status> &Status) {
+    StatEntry Entry;
+    if (Status)
+      Entry.Status = *Status;
+    else
+      Entry.Error = Status.getError();
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Statuses[Path] = Entry;
+  }
+
+  ErrorOr<vfs::Status> CachingFileSystem::status(const Twine &Path) {
+    SmallString<256> Storage;
+    auto P = Path.toStringRef(Storage);
+    if (isUncached(P))
+      return Underlying->status(P);
+
+    StatEntry Entry;
+    if (lookupStatus(P, Entry)) {
+      SavedStats++;
+      if (Entry.Error)
+        return Entry.Error;
+      return Entry.Status;
+    }
+
+    // stat outside the lock, the same path stats the same on any thread
+    Stats++;
+    auto Status = Underlying->status(P);
+    insertStatus(P, Status);
+    return Status;
+  }
+
+  ErrorOr<std::unique_ptr<vfs::File>>
+  CachingFileSystem::openFileForRead(const Twine &Path) {
+    SmallString<256> Storage;
+    auto P = Path.toStringRef(Storage);
+    if (isUncached(P))
+      return Underlying->openFileForRead(P);
+
+    // known to be missing, or already read and in memory
+    StatEntry Entry;
+    bool HasStatus = lookupStatus(P, Entry);
+    if (HasStatus && Entry.Error) {
+      SavedOpens++;
+      return Entry.Error;
+    }
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (HasStatus && Buffers.count(P)) {
+        SavedOpens++;
+        return std::unique_ptr<vfs::File>(
+          new CachedFile(*this, P, std::unique_ptr<vfs::File>()));
+      }
+    }
+
+    Opens++;
+    auto Opened = Underlying->openFileForRead(P);
+    if (!Opened) {
+      if (Opened.getError() == std::errc::no_such_file_or_directory)
+        insertStatus(P, Opened.getError());
+      return Opened.getError();
+    }
+    if (!HasStatus)
+      insertStatus(P, (*Opened)->status());
+    return std::unique_ptr<vfs::File>(
+      new CachedFile(*this, P, std::move(*Opened)));
+  }
+
+  vfs::directory_iterator CachingFileSystem::dir_begin(const Twine &Dir,
+                                                       std::error_code &EC) {
+    // only used for framework and module lookups, rare enough to pass on
+    return Underlying->dir_begin(Dir, EC);
+  }
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>>
+  CachingFileSystem::getBuffer(StringRef Path, vfs::File *Opened,
+                               const Twine &Name, int64_t FileSize,
+                               bool RequiresNullTerminator, bool IsVolatile) {
+    // the cached buffer outlives every translation unit, so hand out
+    // references to it
+    if (!IsVolatile) {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      auto Found = Buffers.find(Path);
+      if (Found != Buffers.end()) {
+        SavedReads++;
+        return MemoryBuffer::getMemBuffer(Found->second->getBuffer(),
+                                          Name.str(), RequiresNullTerminator);
+      }
+    }
+
+    std::unique_ptr<vfs::File> Reopened;
+    if (!Opened) {
+      auto File = Underlying->openFileForRead(Path);
+      if (!File)
+        return File.getError();
+      Reopened = std::move(*File);
+      Opened = Reopened.get();
+    }
+
+    // always null terminated, so the same buffer serves either kind of read
+    Reads++;
+    auto Buffer = Opened->getBuffer(Name, FileSize, true, IsVolatile);
+    if (!Buffer || IsVolatile)
+      return Buffer;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    auto &Cached = Buffers[Path];
+    if (!Cached)
+      Cached = std::move(*Buffer);
+    return MemoryBuffer::getMemBuffer(Cached->getBuffer(), Name.str(),
+                                      RequiresNullTerminator);
+  }
+
+  void CachingFileSystem::printStats(raw_ostream &OS) const {
+    OS << "File system cache: " << SavedStats << " of " << (Stats + SavedStats)
+       << " stats (" << percentSaved(Stats, SavedStats) << "%), " << SavedOpens
+       << " of " << (Opens + SavedOpens) << " opens ("
+       << percentSaved(Opens, SavedOpens) << "%) and " << SavedReads << " of "
+       << (Reads + SavedReads) << " reads (" << percentSaved(Reads, SavedReads)
+       << "%) saved\n";
+  }
+
+} // end namespace import_tidy
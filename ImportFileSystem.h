@@ -0,0 +1,76 @@
+#ifndef __LLVM__ImportFileSystem__
+#define __LLVM__ImportFileSystem__
+
+#include "clang/Basic/VirtualFileSystem.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // A file system shared by the FileManagers of every translation unit in a
+  // run. Stats, including the many failed ones of header search, and file
+  // contents are fetched once and then served from memory, so the thousands
+  // of SDK headers every unit includes are only touched the first time.
+  // Nothing is invalidated during a run. A runner keeps it for its next run
+  // and revalidates it first, so a server stays warm between requests.
+  class CachingFileSystem : public clang::vfs::FileSystem {
+  public:
+    CachingFileSystem(llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> FS) :
+      Underlying(FS), Stats(0), SavedStats(0), Opens(0), SavedOpens(0),
+      Reads(0), SavedReads(0) {};
+
+    // files that are written during the run, like built modules
+    void addUncachedDirectory(llvm::StringRef Directory);
+
+    // files that don't change between runs, like the SDK, their entries
+    // are kept without being checked
+    void addStableDirectory(llvm::StringRef Directory);
+
+    // drops the entries of files outside the stable directories whose
+    // status changed since they were cached, only between runs
+    void revalidate();
+
+    llvm::ErrorOr<clang::vfs::Status> status(const llvm::Twine &Path) override;
+    llvm::ErrorOr<std::unique_ptr<clang::vfs::File>>
+      openFileForRead(const llvm::Twine &Path) override;
+    clang::vfs::directory_iterator dir_begin(const llvm::Twine &Dir,
+                                             std::error_code &EC) override;
+
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+      getBuffer(llvm::StringRef Path, clang::vfs::File *Opened,
+                const llvm::Twine &Name, int64_t FileSize,
+                bool RequiresNullTerminator, bool IsVolatile);
+    void printStats(llvm::raw_ostream&) const;
+  private:
+    struct StatEntry {
+      std::error_code Error;
+      clang::vfs::Status Status;
+    };
+    bool isUncached(llvm::StringRef Path) const;
+    bool isStable(llvm::StringRef Path) const;
+    bool lookupStatus(llvm::StringRef Path, StatEntry&);
+    void insertStatus(llvm::StringRef Path, const llvm::ErrorOr<clang::vfs::Status>&);
+    llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> Underlying;
+    std::vector<std::string> UncachedDirectories;
+    std::vector<std::string> StableDirectories;
+    std::mutex Mutex;
+    llvm::StringMap<StatEntry> Statuses;
+    llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> Buffers;
+
+    // calls that reached the underlying file system and calls saved
+    std::atomic<unsigned> Stats;
+    std::atomic<unsigned> SavedStats;
+    std::atomic<unsigned> Opens;
+    std::atomic<unsigned> SavedOpens;
+    std::atomic<unsigned> Reads;
+    std::atomic<unsigned> SavedReads;
+  };
+}
+
+#endif /* defined(__LLVM__ImportFileSystem__) */
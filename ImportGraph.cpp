@@ -0,0 +1,225 @@
+#include "ImportGraph.h"
+#include "ImportStats.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include <algorithm>
+
+using namespace llvm;
+
+namespace {
+
+  // the number of project headers listed by rebuild impact
+  static const unsigned kReportedHeaders = 10;
+
+  static void addEdge(std::vector<unsigned> &Edges, unsigned To) {
+    if (std::find(Edges.begin(), Edges.end(), To) == Edges.end())
+      Edges.push_back(To);
+  }
+
+  static StringRef edgeLabel(import_tidy::ImportType Type) {
+    using import_tidy::ImportType;
+    switch (Type) {
+      case ImportType::Module: return "Module";
+      case ImportType::Library: return "Library";
+      case ImportType::File: return "File";
+      case ImportType::ForwardDeclareClass:
+      case ImportType::ForwardDeclareProtocol: return "ForwardDeclare";
+    }
+    llvm_unreachable("unknown import type");
+  }
+
+  static void writeDOTString(raw_ostream &OS, StringRef S) {
+    OS << '"';
+    for (auto C : S) {
+      if (C == '"' || C == '\\')
+        OS << '\\';
+      OS << C;
+    }
+    OS << '"';
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - ImportGraph
+
+  unsigned ImportGraph::node(StringRef Path) {
+    auto Inserted = Indices.insert(std::make_pair(Path, unsigned(Nodes.size())));
+    if (Inserted.second) {
+      Node N;
+      N.Path = Path;
+      Nodes.push_back(std::move(N));
+    }
+    return Inserted.first->second;
+  }
+
+  void ImportGraph::addTranslationUnit(StringRef MainFile,
+                                       const std::vector<IncludeEdge> &Edges) {
+    auto Unit = node(MainFile);
+    if (std::find(Units.begin(), Units.end(), Unit) == Units.end())
+      Units.push_back(Unit);
+
+    for (auto &Edge : Edges) {
+      auto From = node(Edge.From);
+      auto To = node(Edge.To);
+      if (From == To)
+        continue;
+      Nodes[To].Size = Edge.Size;
+      Nodes[To].IsSystem = Edge.IsSystem;
+      addEdge(Nodes[From].Edges, To);
+    }
+  }
+
+  void ImportGraph::setTidiedImports(StringRef File,
+                                     const std::vector<std::string> &ImportedFiles) {
+    // indices and not references, adding nodes may move the others
+    auto From = node(File);
+    Nodes[From].IsTidied = true;
+    Nodes[From].TidiedEdges.clear();
+    for (auto &Path : ImportedFiles) {
+      auto To = node(Path);
+      addEdge(Nodes[From].TidiedEdges, To);
+    }
+  }
+
+  ImportGraph::Totals ImportGraph::analyze(bool Tidied) const {
+    Totals T;
+    T.Impacts.assign(Nodes.size(), 0);
+
+    // every file each translation unit includes, directly or not
+    std::vector<unsigned> Visited(Nodes.size(), 0);
+    std::vector<unsigned> Stack;
+    unsigned Generation = 0;
+    for (auto Unit : Units) {
+      Generation++;
+      Stack.assign(1, Unit);
+      Visited[Unit] = Generation;
+      while (!Stack.empty()) {
+        auto &N = Nodes[Stack.back()];
+        Stack.pop_back();
+
+        for (auto To : Tidied && N.IsTidied ? N.TidiedEdges : N.Edges) {
+          if (Visited[To] == Generation)
+            continue;
+          Visited[To] = Generation;
+          Stack.push_back(To);
+
+          T.Bytes += Nodes[To].Size;
+          if (!Nodes[To].IsSystem) {
+            T.Impacts[To]++;
+            T.RebuildImpact++;
+          }
+        }
+      }
+    }
+    return T;
+  }
+
+  void ImportGraph::print(raw_ostream &OS) const {
+    if (Units.empty())
+      return;
+
+    auto Before = analyze(false);
+    auto After = analyze(true);
+
+    OS << "\n\n";
+    OS << "-----------------------------------" << "\n";
+    OS << "Include graph before and after tidy" << "\n";
+    OS << "-----------------------------------" << "\n";
+    OS << "Translation units: " << Units.size() << ", files: " << Nodes.size() << "\n";
+    OS << "Rebuild impact (translation units including each project header, "
+       << "summed): " << Before.RebuildImpact << " -> " << After.RebuildImpact << "\n";
+    OS << "Included bytes per translation unit: "
+       << format("%.1f", Before.Bytes / 1024.0 / Units.size()) << " KB -> "
+       << format("%.1f", After.Bytes / 1024.0 / Units.size()) << " KB\n";
+
+    std::vector<unsigned> Headers;
+    for (unsigned I = 0; I < Nodes.size(); I++) {
+      if (Before.Impacts[I] > 0 || After.Impacts[I] > 0)
+        Headers.push_back(I);
+    }
+    std::sort(Headers.begin(), Headers.end(), [&](unsigned L, unsigned R) {
+      if (Before.Impacts[L] != Before.Impacts[R])
+        return Before.Impacts[L] > Before.Impacts[R];
+      return Nodes[L].Path < Nodes[R].Path;
+    });
+    if (Headers.size() > kReportedHeaders)
+      Headers.resize(kReportedHeaders);
+
+    for (auto I : Headers) {
+      OS << Nodes[I].Path << " : rebuilds " << Before.Impacts[I] << " -> "
+         << After.Impacts[I] << " translation units\n";
+    }
+  }
+
+#pragma mark - GraphWriter
+
+  bool GraphWriter::open(StringRef Path, Format F) {
+    std::error_code EC;
+    OS.reset(new raw_fd_ostream(Path, EC, sys::fs::F_Text));
+    if (EC) {
+      OS.reset();
+      return false;
+    }
+
+    Kind = F;
+    Empty = true;
+    if (Kind == Format::JSON)
+      *OS << "{\"edges\": [";
+    else
+      *OS << "digraph imports {\n";
+    return true;
+  }
+
+  void GraphWriter::addFile(const FileImports &File) {
+    if (!OS)
+      return;
+
+    for (auto &Edge : File.Edges) {
+      auto Label = edgeLabel(Edge.Type);
+      if (Kind == Format::JSON) {
+        *OS << (Empty ? "\n" : ",\n") << "{\"from\": ";
+        writeJSONString(*OS, File.Path);
+        *OS << ", \"to\": ";
+        writeJSONString(*OS, Edge.To);
+        *OS << ", \"kind\": \"" << Label << "\", \"name\": ";
+        writeJSONString(*OS, Edge.Name);
+        *OS << ", \"decls\": [";
+        for (size_t I = 0; I < Edge.Decls.size(); I++) {
+          if (I > 0)
+            *OS << ", ";
+          writeJSONString(*OS, Edge.Decls[I]);
+        }
+        *OS << "]}";
+      } else {
+        std::string Decls;
+        for (auto &Decl : Edge.Decls)
+          Decls += (Decls.empty() ? "" : ", ") + Decl;
+        *OS << "  ";
+        writeDOTString(*OS, File.Path);
+        *OS << " -> ";
+        writeDOTString(*OS, Edge.To);
+        *OS << " [label=\"" << Label << "\", tooltip=";
+        writeDOTString(*OS, Decls);
+        *OS << "];\n";
+      }
+      Empty = false;
+    }
+  }
+
+  bool GraphWriter::close() {
+    if (!OS)
+      return false;
+
+    if (Kind == Format::JSON)
+      *OS << "\n]}\n";
+    else
+      *OS << "}\n";
+    OS->close();
+    bool Closed = !OS->has_error();
+    OS.reset();
+    return Closed;
+  }
+
+} // end namespace import_tidy
@@ -0,0 +1,71 @@
+#ifndef __LLVM__ImportGraph__
+#define __LLVM__ImportGraph__
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include "ImportResult.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // The project wide graph of the includes every translation unit saw, and
+  // the same graph with the outgoing edges of each tidied file replaced by
+  // the imports written to it. Comparing the two shows what tidying does to
+  // the bytes each translation unit includes and to the rebuild impact of
+  // the project headers, how many translation units include each of them.
+  class ImportGraph {
+  public:
+    void addTranslationUnit(llvm::StringRef MainFile,
+                            const std::vector<IncludeEdge>&);
+    void setTidiedImports(llvm::StringRef File,
+                          const std::vector<std::string> &ImportedFiles);
+    void print(llvm::raw_ostream&) const;
+  private:
+    struct Node {
+      Node() : Size(0), IsSystem(false), IsTidied(false) {};
+
+      std::string Path;
+      uint64_t Size;
+      bool IsSystem;
+      bool IsTidied;
+      std::vector<unsigned> Edges;
+      std::vector<unsigned> TidiedEdges;
+    };
+    struct Totals {
+      Totals() : RebuildImpact(0), Bytes(0) {};
+
+      uint64_t RebuildImpact;
+      uint64_t Bytes;
+      std::vector<unsigned> Impacts;
+    };
+    unsigned node(llvm::StringRef Path);
+    Totals analyze(bool Tidied) const;
+    std::vector<Node> Nodes;
+    llvm::StringMap<unsigned> Indices;
+    std::vector<unsigned> Units;
+  };
+
+  // Streams the import edges of every tidied file to a JSON or DOT file as
+  // results are merged. Each file is added once, main files when their
+  // first translation unit is merged and headers with the union of every
+  // unit once all are, so nothing but the output is kept in memory.
+  class GraphWriter {
+  public:
+    enum class Format { JSON, DOT };
+
+    GraphWriter() : Kind(Format::JSON), Empty(true) {};
+
+    bool open(llvm::StringRef Path, Format);
+    void addFile(const FileImports&);
+    bool close();
+  private:
+    std::unique_ptr<llvm::raw_fd_ostream> OS;
+    Format Kind;
+    bool Empty;
+  };
+}
+
+#endif /* defined(__LLVM__ImportGraph__) */
@@ -0,0 +1,373 @@
+#include "ImportIndex.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+
+  // bump whenever what is indexed changes
+  static const uint64_t kIndexVersion = 2;
+  static const char kIndexMagic[] = "import-tidy-index";
+
+  static void writeStrings(raw_ostream &OS, const std::vector<std::string> &Strings) {
+    import_tidy::writeNumber(OS, Strings.size());
+    for (auto &S : Strings)
+      import_tidy::writeString(OS, S);
+  }
+
+  static bool readStrings(StringRef &Buffer, std::vector<std::string> &Strings) {
+    uint64_t Count;
+    if (!import_tidy::readNumber(Buffer, Count))
+      return false;
+    Strings.resize(Count);
+    for (auto &S : Strings)
+      if (!import_tidy::readString(Buffer, S))
+        return false;
+    return true;
+  }
+
+  static StringRef rawSpelling(const Token &Tok) {
+    if (Tok.is(tok::raw_identifier))
+      return Tok.getRawIdentifier();
+    if (Tok.isLiteral())
+      return StringRef(Tok.getLiteralData(), Tok.getLength());
+    if (auto *Punctuator = tok::getPunctuatorSpelling(Tok.getKind()))
+      return Punctuator;
+    return tok::getTokenName(Tok.getKind());
+  }
+
+  // the standard output of git run with Args, false if it failed
+  static bool runGit(ArrayRef<const char*> Args, std::string &Output) {
+    auto Git = sys::findProgramByName("git");
+    if (!Git)
+      return false;
+
+    SmallString<128> OutputPath;
+    if (sys::fs::createTemporaryFile("import-tidy-git", "txt", OutputPath))
+      return false;
+
+    std::vector<const char*> Argv;
+    Argv.push_back(Git->c_str());
+    Argv.insert(Argv.end(), Args.begin(), Args.end());
+    Argv.push_back(nullptr);
+
+    StringRef Redirect(OutputPath);
+    StringRef Empty;
+    const StringRef *Redirects[] = { &Empty, &Redirect, &Empty };
+    int Status = sys::ExecuteAndWait(*Git, Argv.data(), nullptr, Redirects);
+
+    auto Buffer = MemoryBuffer::getFile(OutputPath);
+    sys::fs::remove(OutputPath.str());
+    if (Status != 0 || !Buffer)
+      return false;
+    Output = (*Buffer)->getBuffer();
+    return true;
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - IncludeIndex
+
+  bool IncludeIndex::load() {
+    auto Buffer = MemoryBuffer::getFile(Path);
+    if (!Buffer)
+      return false;
+
+    StringRef Data = (*Buffer)->getBuffer();
+    std::string Magic;
+    uint64_t Version, Count;
+    if (!readString(Data, Magic) || Magic != kIndexMagic ||
+        !readNumber(Data, Version) || Version != kIndexVersion ||
+        !readNumber(Data, Count))
+      return false;
+
+    StringMap<Entry> Loaded;
+    for (uint64_t I = 0; I < Count; I++) {
+      std::string Source;
+      Entry E;
+      if (!readString(Data, Source) || !readNumber(Data, E.Time) ||
+          !readStrings(Data, E.Dependencies) || !readStrings(Data, E.Headers) ||
+          !readString(Data, E.File) || !readString(Data, E.Block))
+        return false;
+      Loaded[Source] = std::move(E);
+    }
+
+    StringMap<std::string> LoadedBlocks;
+    if (!readNumber(Data, Count))
+      return false;
+    for (uint64_t I = 0; I < Count; I++) {
+      std::string Header, Block;
+      if (!readString(Data, Header) || !readString(Data, Block))
+        return false;
+      LoadedBlocks[Header] = Block;
+    }
+
+    Entries = std::move(Loaded);
+    HeaderBlocks = std::move(LoadedBlocks);
+    return true;
+  }
+
+  bool IncludeIndex::save() const {
+    int FD;
+    SmallString<256> TempPath;
+    if (sys::fs::create_directories(sys::path::parent_path(Path)) ||
+        sys::fs::createUniqueFile(Path + "-%%%%%%.tmp", FD, TempPath))
+      return false;
+
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      writeString(OS, kIndexMagic);
+      writeNumber(OS, kIndexVersion);
+      writeNumber(OS, Entries.size());
+      for (auto &E : Entries) {
+        writeString(OS, E.getKey());
+        writeNumber(OS, E.getValue().Time);
+        writeStrings(OS, E.getValue().Dependencies);
+        writeStrings(OS, E.getValue().Headers);
+        writeString(OS, E.getValue().File);
+        writeString(OS, E.getValue().Block);
+      }
+      writeNumber(OS, HeaderBlocks.size());
+      for (auto &Block : HeaderBlocks) {
+        writeString(OS, Block.getKey());
+        writeString(OS, Block.getValue());
+      }
+      OS.close();
+      if (OS.has_error()) {
+        OS.clear_error();
+        sys::fs::remove(TempPath.str());
+        return false;
+      }
+    }
+
+    // readers only ever see a complete index
+    if (sys::fs::rename(TempPath.str(), Path)) {
+      sys::fs::remove(TempPath.str());
+      return false;
+    }
+    return true;
+  }
+
+  void IncludeIndex::addResult(StringRef Source, const TUResult &Result,
+                               uint64_t Time) {
+    // a translation unit that failed has no dependencies, keep what an
+    // earlier run knew about it
+    if (Result.Dependencies.empty())
+      return;
+
+    Entry E;
+    E.Time = Time;
+    E.Dependencies = Result.Dependencies;
+    for (auto &File : Result.Files) {
+      if (File.IsHeader) {
+        E.Headers.push_back(File.Path);
+      } else {
+        E.File = File.Path;
+        E.Block = importBlockFingerprint(File.Block);
+      }
+    }
+    Entries[Source] = std::move(E);
+  }
+
+  void IncludeIndex::addHeaderBlock(StringRef Header, StringRef Block) {
+    HeaderBlocks[Header] = importBlockFingerprint(Block.str());
+  }
+
+  std::vector<std::string>
+  IncludeIndex::affectedSources(ArrayRef<std::string> Sources,
+                                ArrayRef<std::string> ChangedFiles) const {
+    StringSet<> Changed;
+    for (auto &File : ChangedFiles)
+      Changed.insert(File);
+
+    std::vector<bool> Affected(Sources.size(), false);
+    StringSet<> Headers;
+    for (size_t I = 0; I < Sources.size(); I++) {
+      auto Found = Entries.find(Sources[I]);
+      if (Found == Entries.end()) {
+        Affected[I] = true;
+        continue;
+      }
+      for (auto &Dependency : Found->getValue().Dependencies) {
+        if (Changed.count(Dependency)) {
+          Affected[I] = true;
+          break;
+        }
+      }
+      if (Affected[I]) {
+        for (auto &Header : Found->getValue().Headers)
+          Headers.insert(Header);
+      }
+    }
+    addSharingSources(Sources, Affected, Headers);
+
+    std::vector<std::string> Result;
+    for (size_t I = 0; I < Sources.size(); I++) {
+      if (Affected[I])
+        Result.push_back(Sources[I]);
+    }
+    return Result;
+  }
+
+  std::vector<bool> IncludeIndex::tidySources(ArrayRef<std::string> Sources,
+                                              vfs::FileSystem &FS) const {
+    std::vector<bool> Affected(Sources.size(), false);
+    StringSet<> Headers;
+    for (size_t I = 0; I < Sources.size(); I++) {
+      auto Found = Entries.find(Sources[I]);
+      if (Found != Entries.end() && isTidy(Found->getValue(), FS))
+        continue;
+
+      Affected[I] = true;
+      if (Found != Entries.end()) {
+        for (auto &Header : Found->getValue().Headers)
+          Headers.insert(Header);
+      }
+    }
+    addSharingSources(Sources, Affected, Headers);
+
+    std::vector<bool> Tidy;
+    for (auto IsAffected : Affected)
+      Tidy.push_back(!IsAffected);
+    return Tidy;
+  }
+
+  bool IncludeIndex::isTidy(const Entry &E, vfs::FileSystem &FS) const {
+    // modified in the same second as the run started is modified since,
+    // which also catches every file the run itself rewrote
+    for (auto &Dependency : E.Dependencies) {
+      auto Status = FS.status(Dependency);
+      if (!Status)
+        return false;
+      if (Status->getLastModificationTime().toEpochTime() >= E.Time)
+        return false;
+    }
+
+    auto blockMatches = [&FS](StringRef File, StringRef Block) {
+      auto Opened = FS.openFileForRead(File);
+      if (!Opened)
+        return false;
+      auto Buffer = (*Opened)->getBuffer(File);
+      return Buffer && importBlockFingerprint((*Buffer)->getBuffer()) == Block;
+    };
+    if (!E.File.empty() && !blockMatches(E.File, E.Block))
+      return false;
+    for (auto &Header : E.Headers) {
+      auto Found = HeaderBlocks.find(Header);
+      if (Found == HeaderBlocks.end() || !blockMatches(Header, Found->getValue()))
+        return false;
+    }
+    return true;
+  }
+
+  void IncludeIndex::addSharingSources(ArrayRef<std::string> Sources,
+                                       std::vector<bool> &Affected,
+                                       StringSet<> &Headers) const {
+    // a header gets the imports of every source that tidies it, all of
+    // them have to run for it to be rewritten
+    bool Grown = true;
+    while (Grown) {
+      Grown = false;
+      for (size_t I = 0; I < Sources.size(); I++) {
+        auto Found = Entries.find(Sources[I]);
+        if (Affected[I] || Found == Entries.end())
+          continue;
+
+        auto &Tidied = Found->getValue().Headers;
+        if (std::none_of(Tidied.begin(), Tidied.end(),
+                         [&](const std::string &H) { return Headers.count(H) > 0; }))
+          continue;
+
+        Affected[I] = true;
+        for (auto &Header : Tidied)
+          Headers.insert(Header);
+        Grown = true;
+      }
+    }
+  }
+
+#pragma mark - Helpers
+
+  std::string importBlockFingerprint(StringRef Code) {
+    LangOptions LangOpts;
+    LangOpts.ObjC1 = LangOpts.ObjC2 = true;
+    Lexer Lex(SourceLocation(), LangOpts, Code.begin(), Code.begin(), Code.end());
+
+    // one normalized line per import, stopping at the first token that
+    // is neither an import nor another preprocessor directive
+    std::string Block;
+    Token Tok;
+    Lex.LexFromRawLexer(Tok);
+    while (Tok.isNot(tok::eof)) {
+      if (Tok.is(tok::hash) && Tok.isAtStartOfLine()) {
+        std::string Line = "#";
+        Lex.LexFromRawLexer(Tok);
+        bool IsImport = Tok.is(tok::raw_identifier) &&
+          (Tok.getRawIdentifier() == "import" || Tok.getRawIdentifier() == "include");
+        while (Tok.isNot(tok::eof) && !Tok.isAtStartOfLine()) {
+          Line += ' ';
+          Line += rawSpelling(Tok);
+          Lex.LexFromRawLexer(Tok);
+        }
+        if (IsImport)
+          Block += Line + '\n';
+        continue;
+      }
+
+      // @import and forward declarations, but not a protocol definition
+      if (Tok.isNot(tok::at))
+        break;
+      std::string Line = "@";
+      Lex.LexFromRawLexer(Tok);
+      if (Tok.isNot(tok::raw_identifier) ||
+          (Tok.getRawIdentifier() != "import" && Tok.getRawIdentifier() != "class" &&
+           Tok.getRawIdentifier() != "protocol"))
+        break;
+      while (Tok.isOneOf(tok::raw_identifier, tok::comma) || Tok.is(tok::period)) {
+        Line += ' ';
+        Line += rawSpelling(Tok);
+        Lex.LexFromRawLexer(Tok);
+      }
+      if (Tok.isNot(tok::semi))
+        break;
+      Block += Line + ";\n";
+      Lex.LexFromRawLexer(Tok);
+    }
+
+    MD5 Hash;
+    Hash.update(Block);
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    SmallString<32> Str;
+    MD5::stringifyResult(Result, Str);
+    return Str.str();
+  }
+
+  bool changedFiles(StringRef Revision, std::vector<std::string> &Files) {
+    std::string TopLevel, Diff;
+    std::string Rev = Revision;
+    if (!runGit({ "rev-parse", "--show-toplevel" }, TopLevel) ||
+        !runGit({ "diff", "--name-only", Rev.c_str(), "--" }, Diff))
+      return false;
+
+    StringRef Root = StringRef(TopLevel).trim();
+    SmallVector<StringRef, 64> Lines;
+    StringRef(Diff).split(Lines, "\n", -1, false);
+    for (auto Line : Lines) {
+      SmallString<256> Path(Root);
+      sys::path::append(Path, Line.trim());
+      Files.push_back(Path.str());
+    }
+    return true;
+  }
+
+} // end namespace import_tidy
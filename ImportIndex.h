@@ -0,0 +1,72 @@
+#ifndef __LLVM__ImportIndex__
+#define __LLVM__ImportIndex__
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/StringRef.h"
+#include "clang/Basic/VirtualFileSystem.h"
+#include "ImportResult.h"
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // What every source included, which headers it tidied and the import
+  // blocks it wrote in the runs so far, kept next to the result cache.
+  // Inverting it gives the sources a change to some files affects, and
+  // the other sources that have to run with them because they tidy the
+  // same headers. The blocks let a run skip sources that are still tidy.
+  class IncludeIndex {
+  public:
+    IncludeIndex(llvm::StringRef Path) : Path(Path) {};
+
+    bool load();
+    bool save() const;
+
+    // Time is when the run that produced the result started, in seconds
+    void addResult(llvm::StringRef Source, const TUResult&, uint64_t Time);
+    void addHeaderBlock(llvm::StringRef Header, llvm::StringRef Block);
+
+    // the sources that include a changed file, have never been indexed,
+    // or share a tidied header with one of those
+    std::vector<std::string>
+      affectedSources(llvm::ArrayRef<std::string> Sources,
+                      llvm::ArrayRef<std::string> ChangedFiles) const;
+
+    // the sources whose files all start with the import blocks the last
+    // run gave them and whose dependencies haven't been modified since,
+    // unless they tidy a header with a source that has to run
+    std::vector<bool> tidySources(llvm::ArrayRef<std::string> Sources,
+                                  clang::vfs::FileSystem&) const;
+  private:
+    struct Entry {
+      Entry() : Time(0) {};
+
+      uint64_t Time;
+      std::vector<std::string> Dependencies;
+      std::vector<std::string> Headers;
+
+      // the tidied main file and the fingerprint of its block
+      std::string File;
+      std::string Block;
+    };
+    bool isTidy(const Entry&, clang::vfs::FileSystem&) const;
+    void addSharingSources(llvm::ArrayRef<std::string> Sources,
+                           std::vector<bool> &Affected,
+                           llvm::StringSet<> &Headers) const;
+    std::string Path;
+    llvm::StringMap<Entry> Entries;
+    llvm::StringMap<std::string> HeaderBlocks;
+  };
+
+  // a hash of the import lines a file starts with, comments, spacing and
+  // other preprocessor directives aside, Code has to be null terminated
+  std::string importBlockFingerprint(llvm::StringRef Code);
+
+  // the files that differ between Revision and the working tree, as
+  // absolute paths, from git diff
+  bool changedFiles(llvm::StringRef Revision, std::vector<std::string> &Files);
+}
+
+#endif /* defined(__LLVM__ImportIndex__) */
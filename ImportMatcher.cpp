@@ -1,7 +1,12 @@
 #include "ImportMatcher.h"
+#include "ImportVisitor.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/ASTMatchers/ASTMatchersInternal.h"
 #include "clang/AST/ExprObjC.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 
@@ -55,19 +60,28 @@ namespace ast_matchers {
 
 namespace {
 
-  static bool haveReplacementForFile(Replacements &Replacements, StringRef Path) {
-    auto Found = std::find_if(Replacements.begin(), Replacements.end(),
-                              [Path](const Replacement &R) {
-                                return R.getFilePath() == Path;
-                              });
-    return Found != Replacements.end();
-  }
-
   unsigned RangeEnd(const Range &R) {
     return R.getOffset() + R.getLength();
   }
 
-  static std::vector<Range> collapsedRanges(const std::vector<Range> &Ranges) {
+  // replacements outlive the translation unit and are applied without
+  // changing directory, so resolve paths against the compile directory
+  static std::string absolutePath(StringRef Path, const SourceManager &SM) {
+    if (llvm::sys::path::is_absolute(Path))
+      return Path;
+
+    SmallString<256> Absolute(SM.getFileManager().getFileSystemOptions().WorkingDir);
+    llvm::sys::path::append(Absolute, Path);
+    return Absolute.str();
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - Helpers
+
+  std::vector<Range> collapsedRanges(const std::vector<Range> &Ranges) {
     std::vector<Range> sorted(Ranges.begin(), Ranges.end());
     if (Ranges.size() == 0)
       return sorted;
@@ -89,14 +103,13 @@ namespace {
     return sorted;
   }
 
-} // end anonymous namespace
-
-namespace import_tidy {
-
 #pragma mark - ImportMatcher
 
   std::unique_ptr<FrontendActionFactory>
   ImportMatcher::getActionFactory(MatchFinder& Finder) {
+    if (!Options.UseMatchers)
+      return newFrontendActionFactory(this, &FileCallbacks);
+
     auto CallMatcher = callExpr(isExpansionInMainFile()).bind(nodeKey);
     auto CastMatcher = cStyleCastExpr(isExpansionInMainFile()).bind(nodeKey);
     auto CategoryMatcher = objcCategoryDecl(isImplementationInMainFile()).bind(nodeKey);
@@ -127,7 +140,73 @@ namespace import_tidy {
     Finder.addMatcher(ProtoDeclMatcher, &ProtoCallback);
     Finder.addMatcher(FuncDecl, &FuncDeclCallback);
 
-    return newFrontendActionFactory(&Finder, &FileCallbacks);
+    this->Finder = &Finder;
+    return newFrontendActionFactory(this, &FileCallbacks);
+  }
+
+  std::unique_ptr<ASTConsumer> ImportMatcher::newASTConsumer() {
+    std::unique_ptr<ASTConsumer> FinderConsumer;
+    if (Finder)
+      FinderConsumer = Finder->newASTConsumer();
+    return std::unique_ptr<ASTConsumer>(new ImportASTConsumer(*this, std::move(FinderConsumer)));
+  }
+
+  void ImportMatcher::recordTimes(Clock::time_point Created, Clock::time_point Start,
+                                  Clock::time_point End) {
+    std::chrono::duration<double, std::milli> ParseMilliseconds = Start - Created;
+    std::chrono::duration<double, std::milli> MatchMilliseconds = End - Start;
+    Result.Stats.ParseTime += ParseMilliseconds.count();
+    Result.Stats.MatchTime += MatchMilliseconds.count();
+    recordPhase("parse", Created, Start);
+    recordPhase("match", Start, End);
+
+    if (Options.PrintMatchTime)
+      llvm::raw_string_ostream(getLog()) << "Parsed in "
+                                         << llvm::format("%.2f", ParseMilliseconds.count())
+                                         << " ms, matched in "
+                                         << llvm::format("%.2f", MatchMilliseconds.count())
+                                         << " ms\n";
+  }
+
+  void ImportMatcher::recordPhase(StringRef Name, Clock::time_point Start,
+                                  Clock::time_point End) {
+    if (!Options.CollectStats)
+      return;
+
+    std::chrono::duration<double, std::micro> Begin = Start.time_since_epoch();
+    std::chrono::duration<double, std::micro> Duration = End - Start;
+    TraceEvent Event = { Name.str(), Begin.count(), Duration.count() };
+    Result.Stats.Events.push_back(std::move(Event));
+  }
+
+  void ImportMatcher::recordMicro(StringRef Name, unsigned Calls,
+                                  Clock::time_point Start, Clock::time_point End) {
+    std::chrono::duration<double, std::micro> Duration = End - Start;
+    auto &Stats = Result.Stats.Micro[Name];
+    Stats.Calls += Calls;
+    Stats.Time += Duration.count();
+  }
+
+  void ImportMatcher::collectCallbackStats() {
+    ImportCallback *Callbacks[] = {
+      &CallCallback, &CastCallback, &CategoryCallback, &DeclRefCallback,
+      &FuncDeclCallback, &InterfaceCallback, &MsgCallback, &MtdCallback,
+      &ProtoCallback, &StripCallback
+    };
+    for (auto *Callback : Callbacks) {
+      if (Options.CollectStats && Callback->getMatches() > 0) {
+        auto &Stats = Result.Stats.Callbacks[Callback->getName()];
+        Stats.Matches += Callback->getMatches();
+        Stats.Time += Callback->getTime();
+      }
+      Callback->resetStats();
+    }
+  }
+
+  bool ImportMatcher::shouldSkipFunctionBody(const Decl *D, const SourceManager &SM) const {
+    // bodies in headers only add imports to files that are rarely tidied
+    return Options.SkipHeaderBodies &&
+           !SM.isInMainFile(SM.getExpansionLoc(D->getLocation()));
   }
 
   void ImportMatcher::addImport(const FileID InFile,
@@ -135,19 +214,73 @@ namespace import_tidy {
                                 const SourceManager &SM,
                                 bool isForwardDeclare) {
     // only allow file locations
-    auto Loc = getDeclLoc(D);
-    if (!SM.getFileEntryForID(InFile) || SM.getFilename(Loc).size() == 0)
+    if (InFile.isInvalid() || !SM.getFileEntryForID(InFile))
+      return;
+    auto &Resolved = resolveImport(D, SM, isForwardDeclare);
+    if (!Resolved.HasFilename)
       return;
 
     // don't include files in themselves
-    if (!isForwardDeclare && SM.getFileID(Loc) == InFile)
+    if (!isForwardDeclare && Resolved.DeclFile == InFile)
       return;
 
-    ImportMap[InFile].push_back(Import(SM, D, isForwardDeclare));
+    // the same decl adds the same import, keep only the first
+    auto &State = fileState(InFile);
+    if (!State.Added.insert(std::make_pair(D, unsigned(isForwardDeclare))).second)
+      return;
+
+    if (!Resolved.Imported) {
+      // finding the top included file is the costly part of an import
+      auto Start = Options.CollectStats ? Clock::now() : Clock::time_point();
+      Resolved.Imported = Import(SM, D, isForwardDeclare);
+      if (Options.ModuleImports && ModulesEnabled &&
+          Resolved.Imported->getType() == ImportType::Library) {
+        auto Framework = umbrellaFramework(Resolved.Imported->getName());
+        if (!Framework.empty() && hasModuleMap(Resolved.Imported->getName(), SM))
+          Resolved.Imported->setModule(Framework);
+      }
+      if (Options.CollectStats) {
+        std::chrono::duration<double, std::micro> Elapsed = Clock::now() - Start;
+        Result.Stats.ResolveTime += Elapsed.count();
+      }
+    }
+    State.Imports.push_back(*Resolved.Imported);
+  }
+
+  bool ImportMatcher::hasModuleMap(StringRef FrameworkHeader, const SourceManager &SM) {
+    // X.framework/Headers/X.h -> X.framework/Modules/module.modulemap,
+    // the file manager and the run's file system cache remember the stat
+    auto Framework = llvm::sys::path::parent_path(
+                       llvm::sys::path::parent_path(FrameworkHeader));
+    SmallString<256> Path(Framework);
+    llvm::sys::path::append(Path, "Modules", "module.modulemap");
+    return SM.getFileManager().getFile(Path) != nullptr;
+  }
+
+  ImportMatcher::ResolvedImport &
+  ImportMatcher::resolveImport(const Decl *D, const SourceManager &SM,
+                               bool isForwardDeclare) {
+    // hot decls are referenced hundreds of times from a single file
+    auto &Resolved = ResolvedImports[isForwardDeclare];
+    auto Found = Resolved.find(D);
+    if (Found != Resolved.end()) {
+      Result.Stats.ImportMemo.Hits++;
+      return Found->second;
+    }
+
+    Result.Stats.ImportMemo.Misses++;
+    auto Loc = getDeclLoc(D);
+    auto &Entry = Resolved[D];
+    Entry.DeclFile = SM.getFileID(Loc);
+    Entry.HasFilename = SM.getFilename(Loc).size() > 0;
+    return Entry;
   }
 
   void ImportMatcher::removeImport(const SourceLocation Loc, const SourceManager &SM) {
     auto fid = SM.getFileID(Loc);
+    if (fid.isInvalid())
+      return;
+
     auto *buffer = SM.getBuffer(fid);
     auto *fileStart = buffer->getBufferStart();
     unsigned start = SM.getFileOffset(Loc);
@@ -158,125 +291,439 @@ namespace import_tidy {
     while (isWhitespace(*c) && c++ < buffer->getBufferEnd())
       length++;
 
-    ImportRanges[fid].push_back(Range(start, length));
+    fileState(fid).Ranges.push_back(Range(start, length));
   }
 
   // TODO: move this into ImportCallbacks as a helper function
   void ImportMatcher::addType(const FileID InFile, QualType T, const SourceManager &SM) {
     bool isMainFile = SM.getMainFileID() == InFile;
 
+    // keyed on the type as written, a canonical type loses its typedefs
+    auto &Memo = TypeImports[isMainFile];
+    auto Found = Memo.find(T);
+    if (Found != Memo.end()) {
+      Result.Stats.TypeMemo.Hits++;
+    } else {
+      Result.Stats.TypeMemo.Misses++;
+      std::vector<TypeImport> Imports;
+      collectTypeImports(T, isMainFile, SM, Imports);
+      Found = Memo.insert(std::make_pair(T, std::move(Imports))).first;
+    }
+
+    for (auto &I : Found->second)
+      addImport(InFile, I.first, SM, I.second);
+  }
+
+  void ImportMatcher::collectTypeImports(QualType T, bool isMainFile,
+                                         const SourceManager &SM,
+                                         std::vector<TypeImport> &Imports) {
     if (auto *PT = T->getAs<ObjCObjectPointerType>()) {
       // import or forward declare the class type
       if (auto *ID = PT->getInterfaceDecl()) {
         auto Filename = SM.getFilename(ID->getLocation());
         bool isSystemDecl = Filename.startswith(getSysroot());
-        addImport(InFile, ID, SM, !isSystemDecl && !isMainFile);
+        bool isForwardDeclare = !isSystemDecl && !isMainFile;
+        Imports.push_back(TypeImport(ID, isForwardDeclare));
       }
 
       // import or forward declare any protocols being conformed to
       for (auto i = PT->qual_begin(); i != PT->qual_end(); i++) {
         auto Filename = SM.getFilename((*i)->getLocation());
         bool isSystemDecl = Filename.startswith(getSysroot());
-        addImport(InFile, *i, SM, !isSystemDecl && !isMainFile);
+        bool isForwardDeclare = !isSystemDecl && !isMainFile;
+        Imports.push_back(TypeImport(*i, isForwardDeclare));
       }
     } else if (auto *TD = T->getAs<TypedefType>()) {
       // any typedefs need to be imported
       if (auto *TypeDecl = TD->getDecl()) {
-        addImport(InFile, TypeDecl, SM);
+        Imports.push_back(TypeImport(TypeDecl, false));
       }
     } else if (auto *BP = T->getAs<BlockPointerType>()) {
       // any types used in blocks need to be imported
       if (auto *FT = BP->getPointeeType()->getAs<FunctionProtoType>()) {
-        addType(InFile, FT->getReturnType(), SM);
+        collectTypeImports(FT->getReturnType(), isMainFile, SM, Imports);
         for (auto PT : FT->param_types()) {
-          addType(InFile, PT, SM);
+          collectTypeImports(PT, isMainFile, SM, Imports);
         }
       }
     }
   }
 
   void ImportMatcher::addHeaderFile(const FileID FID) {
-    HeaderFiles.insert(FID);
+    // the invalid FileID is the empty key of the dense tables
+    if (FID.isValid())
+      HeaderFiles.insert(FID);
+  }
+
+  void ImportMatcher::addProjectFile(const FileID FID) {
+    if (FID.isValid())
+      ProjectFiles.insert(FID);
+  }
+
+  bool ImportMatcher::isInProjectFile(SourceLocation Loc, const SourceManager &SM) const {
+    if (Loc.isInvalid())
+      return false;
+    auto FID = SM.getFileID(SM.getExpansionLoc(Loc));
+    return FID.isValid() && ProjectFiles.count(FID) > 0;
+  }
+
+  ImportMatcher::FileState &ImportMatcher::fileState(FileID FID) {
+    auto Found = FileIndices.find(FID);
+    if (Found != FileIndices.end())
+      return Files[Found->second];
+
+    // reuse the storage a previous translation unit left behind
+    if (FilesUsed == Files.size())
+      Files.resize(Files.size() + 1);
+    FileIndices[FID] = FilesUsed;
+    return Files[FilesUsed++];
+  }
+
+  void ImportMatcher::addDependency(StringRef Path, const SourceManager &SM) {
+    if (RecordDependencies)
+      Dependencies.insert(absolutePath(Path, SM));
+  }
+
+  void ImportMatcher::addInclude(const FileID From, const FileEntry *To) {
+    if (Options.IncludeGraph && From.isValid())
+      Includes.push_back(std::make_pair(From, To));
   }
 
   void ImportMatcher::flush(const SourceManager &SM) {
-    auto &out = llvm::outs();
-    auto HeaderImports = headerImportedFiles(SM);
-    std::set<FileID> EmptyImports;
+    auto FlushStart = Clock::now();
+    auto MainFile = SM.getFileEntryForID(SM.getMainFileID());
+    if (MainFile)
+      addDependency(MainFile->getName(), SM);
+
+    llvm::DenseSet<FileID> HeaderImports;
+    if (!Options.MainFilesOnly)
+      HeaderImports = headerImportedFiles(SM);
+    llvm::DenseSet<FileID> EmptyImports;
     HeaderFiles.insert(SM.getMainFileID());
 
-    for (auto &Pair : ImportMap) {
+    // visit files in FileID order, the dense table is unordered
+    std::vector<FileID> Fids;
+    Fids.reserve(FileIndices.size());
+    for (auto &Pair : FileIndices)
+      Fids.push_back(Pair.first);
+    std::sort(Fids.begin(), Fids.end());
+
+    for (auto Fid : Fids) {
       // only tidy the main file and files with interfaces
       // implemented in the main file
-      if (HeaderFiles.count(Pair.first) == 0)
+      auto &State = Files[FileIndices[Fid]];
+      if (State.Imports.empty() || HeaderFiles.count(Fid) == 0)
+        continue;
+      if (Options.MainFilesOnly && Fid != SM.getMainFileID())
         continue;
 
+      auto StartLoc = SM.getLocForStartOfFile(Fid);
+      FileImports File;
+      File.Path = absolutePath(SM.getFilename(StartLoc), SM);
+      File.ModulesEnabled = ModulesEnabled;
+
+      // a header with the same content and requirements as in an earlier
+      // unit tidies the same, take that unit's work
+      std::string HeaderKey;
+      std::shared_ptr<HeaderCache::Entry> Entry;
+      if (Headers && Fid != SM.getMainFileID()) {
+        HeaderKey = headerKey(File.Path, Fid, State.Imports, SM);
+        if (auto Cached = Headers->lookup(HeaderKey)) {
+          for (auto &Name : Cached->Libraries)
+            Result.LibraryCounts[Name]++;
+          for (auto &Path : Cached->Files)
+            Result.FileCounts[Path]++;
+          Result.Files.push_back(Cached->File);
+          continue;
+        }
+        Entry = std::make_shared<HeaderCache::Entry>();
+      }
+
       std::string import;
       llvm::raw_string_ostream ImportStr(import);
-      auto &Excluded = SM.getMainFileID() == Pair.first ? HeaderImports : EmptyImports;
-      auto Imports = sortedUniqueImports(SM, Pair.second, Excluded);
+      auto &Excluded = SM.getMainFileID() == Fid ? HeaderImports : EmptyImports;
+      auto SortStart = Clock::now();
+      auto Imports = sortedUniqueImports(SM, State.Imports, Excluded);
+      recordPhase("sortedUniqueImports", SortStart, Clock::now());
       for (auto *Import : Imports) {
         ImportStr << *Import << '\n';
+        if (Options.IncludeGraph && !Import->isForwardDeclare())
+          File.ImportedFiles.push_back(absolutePath(SM.getFilename(
+            SM.getLocForStartOfFile(Import->getFile())), SM));
         if (Import->getType() == ImportType::Library) {
-          LibraryCounts[Import->getName()]++;
+          Result.LibraryCounts[Import->getName()]++;
+          if (Entry)
+            Entry->Libraries.push_back(Import->getName());
+        } else if (Import->getType() == ImportType::File) {
+          auto Path = absolutePath(SM.getFilename(
+            SM.getLocForStartOfFile(Import->getFile())), SM);
+          Result.FileCounts[Path]++;
+          if (Entry)
+            Entry->Files.push_back(Path);
         }
       }
       ImportStr << '\n';
+      File.Block = ImportStr.str();
+      if (Options.ImportEdges)
+        addImportEdges(File, Imports, State.Imports, SM);
 
-      auto Fid = Pair.first;
-      auto StartLoc = SM.getLocForStartOfFile(Fid);
-      auto Path = SM.getFilename(StartLoc);
-      if (haveReplacementForFile(Replacements, Path))
-        continue;
-
-      auto ReplacementRanges = collapsedRanges(ImportRanges[Fid]);
+      auto CollapseStart = Clock::now();
+      auto ReplacementRanges = collapsedRanges(State.Ranges);
+      recordPhase("collapsedRanges", CollapseStart, Clock::now());
       if (ReplacementRanges.size() > 0) {
         for (auto I = ReplacementRanges.cbegin(); I != ReplacementRanges.cend(); I++) {
-          auto Text = I == ReplacementRanges.cbegin() ? ImportStr.str() : "";
-          auto Start = StartLoc.getLocWithOffset(I->getOffset());
-          Replacements.insert(Replacement(SM, Start, I->getLength(), Text));
+          auto Text = I == ReplacementRanges.cbegin() ? File.Block : "";
+          File.Replacements.push_back(Replacement(File.Path, I->getOffset(),
+                                                  I->getLength(), Text));
         }
       } else {
-        Replacements.insert(Replacement(SM, StartLoc, 0, ImportStr.str()));
+        File.Replacements.push_back(Replacement(File.Path, 0, 0, File.Block));
       }
 
-      out << "File: " << SM.getFilename(StartLoc) << "\n";
-      out << ImportStr.str() << "\n";
+      // other translation units can need more imports in the same header,
+      // keep everything the merge needs to combine them
+      if (Fid != SM.getMainFileID())
+        addHeaderImports(File, State.Imports, SM);
+      if (Entry) {
+        Entry->File = File;
+        Headers->insert(HeaderKey, std::move(Entry));
+      }
+      Result.Files.push_back(std::move(File));
+    }
+    flushIncludes(SM);
+    for (unsigned I = 0; I < FilesUsed; I++) {
+      Files[I].Imports.clear();
+      Files[I].Added.clear();
+      Files[I].Ranges.clear();
     }
-    ImportMap.clear();
-    ImportRanges.clear();
+    FilesUsed = 0;
+    FileIndices.clear();
     HeaderFiles.clear();
+    ProjectFiles.clear();
+    for (auto &Memo : ResolvedImports)
+      Memo.clear();
+    for (auto &Memo : TypeImports)
+      Memo.clear();
+
+    collectCallbackStats();
+    recordPhase("flush", FlushStart, Clock::now());
   }
 
-  void ImportMatcher::printLibraryCounts(llvm::raw_ostream &OS) {
-    if (LibraryCounts.size() == 0)
-      return;
+  void ImportMatcher::benchmark(const SourceManager &SM) {
+    // the same files flush would tidy, with the imports it would exclude
+    llvm::DenseSet<FileID> HeaderImports;
+    if (!Options.MainFilesOnly)
+      HeaderImports = headerImportedFiles(SM);
+    llvm::DenseSet<FileID> EmptyImports;
+    std::vector<std::pair<FileID, const FileState*>> Tidied;
+    for (auto &Pair : FileIndices) {
+      auto &State = Files[Pair.second];
+      auto IsMain = Pair.first == SM.getMainFileID();
+      if (!State.Imports.empty() && (IsMain || HeaderFiles.count(Pair.first) > 0))
+        Tidied.push_back(std::make_pair(Pair.first, &State));
+    }
+    std::sort(Tidied.begin(), Tidied.end(),
+              [](const std::pair<FileID, const FileState*> &L,
+                 const std::pair<FileID, const FileState*> &R) {
+                return L.first < R.first;
+              });
+
+    auto Iterations = Options.MicroBenchIterations;
+    unsigned Calls = 0;
+    auto Start = Clock::now();
+    for (unsigned I = 0; I < Iterations; I++) {
+      for (auto &Pair : Tidied) {
+        auto &Excluded = SM.getMainFileID() == Pair.first ? HeaderImports : EmptyImports;
+        sortedUniqueImports(SM, Pair.second->Imports, Excluded);
+        Calls++;
+      }
+    }
+    recordMicro("sortedUniqueImports", Calls, Start, Clock::now());
+
+    Calls = 0;
+    Start = Clock::now();
+    for (unsigned I = 0; I < Iterations; I++) {
+      for (auto &Pair : Tidied) {
+        collapsedRanges(Pair.second->Ranges);
+        Calls++;
+      }
+    }
+    recordMicro("collapsedRanges", Calls, Start, Clock::now());
+
+    Calls = 0;
+    Start = Clock::now();
+    for (unsigned I = 0; I < Iterations; I++) {
+      for (auto &Pair : Tidied) {
+        for (auto &Import : Pair.second->Imports) {
+          if (!Import.getDecl())
+            continue;
+          topFileIncludingFile(SM.getFileID(getDeclLoc(Import.getDecl())), SM);
+          Calls++;
+        }
+      }
+    }
+    recordMicro("topFileIncludingFile", Calls, Start, Clock::now());
+
+    // flush empties the tables, run it on copies and put back the
+    // result and the tables for the real flush. The header cache is
+    // left out so every iteration does the full work
+    collectCallbackStats();
+    std::vector<FileState> SavedFiles(Files.begin(), Files.begin() + FilesUsed);
+    auto SavedIndices = FileIndices;
+    auto SavedHeaderFiles = HeaderFiles;
+    auto SavedProjectFiles = ProjectFiles;
+    auto SavedIncludes = Includes;
+    auto SavedResult = Result;
+    auto *SavedHeaders = Headers;
+    Headers = nullptr;
+    auto restore = [&]() {
+      std::copy(SavedFiles.begin(), SavedFiles.end(), Files.begin());
+      FilesUsed = SavedFiles.size();
+      FileIndices = SavedIndices;
+      HeaderFiles = SavedHeaderFiles;
+      ProjectFiles = SavedProjectFiles;
+      Includes = SavedIncludes;
+    };
+
+    std::chrono::duration<double, std::micro> FlushTime(0);
+    for (unsigned I = 0; I < Iterations; I++) {
+      auto FlushStart = Clock::now();
+      flush(SM);
+      FlushTime += Clock::now() - FlushStart;
+      restore();
+      Result = SavedResult;
+    }
+    Headers = SavedHeaders;
 
-    using ImpPair = std::pair<StringRef, unsigned>;
-    std::vector<ImpPair> counts(LibraryCounts.begin(), LibraryCounts.end());
-    std::sort(counts.begin(), counts.end(), [](const ImpPair &L, const ImpPair &R) {
-      return L.second < R.second;
-    });
+    auto &Stats = Result.Stats.Micro["flush"];
+    Stats.Calls += Iterations;
+    Stats.Time += FlushTime.count();
+  }
+
+  void ImportMatcher::flushIncludes(const SourceManager &SM) {
+    std::set<std::pair<std::string, std::string>> Seen;
+    for (auto &Include : Includes) {
+      IncludeEdge Edge;
+      Edge.From = absolutePath(SM.getFilename(SM.getLocForStartOfFile(Include.first)), SM);
+      Edge.To = absolutePath(Include.second->getName(), SM);
+      if (!Seen.insert(std::make_pair(Edge.From, Edge.To)).second)
+        continue;
+
+      // a file that was never entered, like a header of a module, has no
+      // FileID in this unit and can only be a system file
+      auto To = SM.translateFile(Include.second);
+      Edge.Size = Include.second->getSize();
+      Edge.IsSystem = To.isInvalid() || ProjectFiles.count(To) == 0;
+      Result.Includes.push_back(std::move(Edge));
+    }
+    Includes.clear();
+  }
+
+  void ImportMatcher::addImportEdges(FileImports &File,
+                                     const std::vector<const Import*> &Imports,
+                                     const std::vector<Import> &All,
+                                     const SourceManager &SM) {
+    // every decl of the file is an import of its own, group them by the
+    // import line they ended up as
+    std::map<std::pair<ImportType, StringRef>, size_t> Indices;
+    for (auto *I : Imports) {
+      ImportEdge Edge;
+      Edge.Type = I->getType();
+      Edge.To = absolutePath(SM.getFilename(SM.getLocForStartOfFile(I->getFile())), SM);
+      Edge.Name = I->getName();
+      Indices[std::make_pair(I->getType(), I->getName())] = File.Edges.size();
+      File.Edges.push_back(std::move(Edge));
+    }
+
+    for (auto &I : All) {
+      auto Found = Indices.find(std::make_pair(I.getType(), I.getName()));
+      auto *ND = dyn_cast_or_null<NamedDecl>(I.getDecl());
+      if (Found != Indices.end() && ND)
+        File.Edges[Found->second].Decls.push_back(ND->getNameAsString());
+    }
+    for (auto &Edge : File.Edges) {
+      std::sort(Edge.Decls.begin(), Edge.Decls.end());
+      Edge.Decls.erase(std::unique(Edge.Decls.begin(), Edge.Decls.end()),
+                       Edge.Decls.end());
+    }
+  }
+
+  void ImportMatcher::addHeaderImports(FileImports &File,
+                                       const std::vector<Import> &Imports,
+                                       const SourceManager &SM) {
+    auto filePath = [&SM](FileID FID) {
+      return absolutePath(SM.getFilename(SM.getLocForStartOfFile(FID)), SM);
+    };
+
+    File.IsHeader = true;
+    for (auto &I : Imports) {
+      HeaderImport Entry;
+      Entry.Type = I.getType();
+      Entry.Name = I.getName();
+      llvm::raw_string_ostream Line(Entry.Line);
+      Line << I;
+      Line.flush();
+      Entry.File = filePath(I.getFile());
+      if (I.getType() == ImportType::Module) {
+        Entry.LibraryName = I.getLibraryName();
+        Entry.LibraryLine = "#import <" + libraryIncludeName(I.getLibraryName()) + ">";
+      }
+      File.Imports.push_back(std::move(Entry));
+    }
+    std::sort(File.Imports.begin(), File.Imports.end());
+    File.Imports.erase(std::unique(File.Imports.begin(), File.Imports.end(),
+                                   [](const HeaderImport &L, const HeaderImport &R) {
+                                     return !(L < R) && !(R < L);
+                                   }),
+                       File.Imports.end());
+
+    for (auto FID : getSuperclasses(Imports, SM))
+      File.Superclasses.push_back(filePath(FID));
+    std::sort(File.Superclasses.begin(), File.Superclasses.end());
+  }
+
+  TUResult ImportMatcher::takeResult() {
+    Result.Dependencies.assign(Dependencies.begin(), Dependencies.end());
+    Dependencies.clear();
+
+    TUResult Taken = std::move(Result);
+    Result = TUResult();
+    return Taken;
+  }
 
-    OS << "\n\n";
-    OS << "--------------------------------" << "\n";
-    OS << "Libraries sorted by import count" << "\n";
-    OS << "--------------------------------" << "\n";
-    const unsigned kThreshold = 5;
-    for (auto I = counts.rbegin(); I != counts.rend() && I->second >= kThreshold; I++) {
-      OS << I->first << " : " << I->second << " times\n";
+  std::string ImportMatcher::headerKey(StringRef Path, FileID Fid,
+                                      const std::vector<Import> &Imports,
+                                      const SourceManager &SM) const {
+    // the same imports in any order give the same block
+    std::vector<size_t> Hashes;
+    Hashes.reserve(Imports.size());
+    for (auto &I : Imports) {
+      auto *Entry = SM.getFileEntryForID(I.getFile());
+      auto *ND = dyn_cast_or_null<NamedDecl>(I.getDecl());
+      Hashes.push_back(llvm::hash_combine(
+        static_cast<unsigned>(I.getType()), I.getName(),
+        Entry ? StringRef(Entry->getName()) : StringRef(),
+        Options.ImportEdges && ND ? ND->getNameAsString() : std::string()));
     }
+    std::sort(Hashes.begin(), Hashes.end());
+    Hashes.erase(std::unique(Hashes.begin(), Hashes.end()), Hashes.end());
+
+    auto Hash = llvm::hash_combine(llvm::hash_value(SM.getBufferData(Fid)),
+                                   ModulesEnabled,
+                                   llvm::hash_combine_range(Hashes.begin(),
+                                                            Hashes.end()));
+    return (Path + Twine('\0') + Twine(uint64_t(size_t(Hash)))).str();
   }
 
-  std::set<FileID> ImportMatcher::headerImportedFiles(const SourceManager &SM) {
-    std::set<FileID> AllFiles;
+  llvm::DenseSet<FileID> ImportMatcher::headerImportedFiles(const SourceManager &SM) {
+    llvm::DenseSet<FileID> AllFiles;
 
-    for (auto &Pair : ImportMap) {
+    for (auto &Pair : FileIndices) {
       if (Pair.first == SM.getMainFileID() ||
           HeaderFiles.count(Pair.first) == 0)
         continue;
 
-      for (auto &Import : Pair.second)
+      for (auto &Import : Files[Pair.second].Imports)
         if (!Import.isForwardDeclare())
           AllFiles.insert(Import.getFile());
     }
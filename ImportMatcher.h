@@ -4,42 +4,162 @@
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/Tooling/Tooling.h"
 #include "clang/Tooling/Refactoring.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
 #include "Import.h"
+#include "ImportCache.h"
 #include "ImportCallbacks.h"
-#include <map>
+#include "ImportResult.h"
+#include <chrono>
 #include <set>
 
 namespace import_tidy {
 
+  struct MatchOptions {
+    MatchOptions() :
+      UseMatchers(false), PrintMatchTime(false),
+      SkipHeaderBodies(false), VerifySkippedBodies(false),
+      CollectStats(false), ModuleImports(false),
+      IncludeGraph(false), ImportEdges(false),
+      MainFilesOnly(false), MicroBenchIterations(0) {};
+
+    // run the AST matchers instead of the single pass visitor
+    bool UseMatchers;
+    bool PrintMatchTime;
+
+    // don't parse function bodies outside the main file, and optionally
+    // parse every file both ways to check the imports are unchanged
+    bool SkipHeaderBodies;
+    bool VerifySkippedBodies;
+
+    // record phase timings and callback counts for -stats-json and -trace
+    bool CollectStats;
+
+    // write @import X; instead of #import <X/X.h> for frameworks with
+    // a module map
+    bool ModuleImports;
+
+    // record every include for the include graph report
+    bool IncludeGraph;
+
+    // keep each import with the decls that needed it for -emit-graph
+    bool ImportEdges;
+
+    // leave headers alone, a single translation unit doesn't know what the
+    // others need in them. The main file then keeps the imports a tidied
+    // header would otherwise provide
+    bool MainFilesOnly;
+
+    // time the flush helpers this many times on each parsed translation
+    // unit before the real flush, 0 doesn't
+    unsigned MicroBenchIterations;
+  };
+
+  // Ranges sorted by offset with overlapping and adjacent ones merged
+  std::vector<clang::tooling::Range>
+  collapsedRanges(const std::vector<clang::tooling::Range> &Ranges);
+
   class ImportMatcher {
+    friend class ImportVisitor;
   public:
-    ImportMatcher(clang::tooling::Replacements &Replacements) :
-      ImportRanges(), ImportMap(), LibraryCounts(),
+    ImportMatcher() :
+      FilesUsed(0), Result(), RecordDependencies(false), ModulesEnabled(false),
+      Headers(nullptr), Finder(nullptr),
       CallCallback(*this), CastCallback(*this),
       CategoryCallback(*this), DeclRefCallback(*this),
       FuncDeclCallback(*this), InterfaceCallback(*this),
       MsgCallback(*this), MtdCallback(*this), ProtoCallback(*this),
-      StripCallback(*this), FileCallbacks(*this), Replacements(Replacements) {};
+      StripCallback(*this), FileCallbacks(*this) {};
 
     std::unique_ptr<clang::tooling::FrontendActionFactory>
       getActionFactory(clang::ast_matchers::MatchFinder&);
+    std::unique_ptr<clang::ASTConsumer> newASTConsumer();
+    void setOptions(const MatchOptions &O) { Options = O; }
+    const MatchOptions &getOptions() const { return Options; }
+    bool shouldSkipFunctionBody(const clang::Decl*, const clang::SourceManager&) const;
     llvm::StringRef getSysroot() { return llvm::StringRef(Sysroot); }
     void setSysroot(std::string SR) { Sysroot = SR; }
+    void setRecordDependencies(bool Record) { RecordDependencies = Record; }
+    void setModulesEnabled(bool Enabled) { ModulesEnabled = Enabled; }
+    void setHeaderCache(HeaderCache *Cache) { Headers = Cache; }
     void addImport(const clang::FileID InFile,
                    const clang::Decl*,
                    const clang::SourceManager&,
                    bool isForwardDeclare = false);
     void removeImport(const clang::SourceLocation, const clang::SourceManager&);
     void addHeaderFile(const clang::FileID);
+    void addProjectFile(const clang::FileID);
+    bool isInProjectFile(clang::SourceLocation, const clang::SourceManager&) const;
+    void addDependency(llvm::StringRef Path, const clang::SourceManager&);
+    void addInclude(const clang::FileID From, const clang::FileEntry *To);
     void addType(const clang::FileID, clang::QualType, const clang::SourceManager&);
+    typedef std::chrono::steady_clock Clock;
+    void recordTimes(Clock::time_point Created, Clock::time_point Start,
+                     Clock::time_point End);
+    void recordPhase(llvm::StringRef Name, Clock::time_point Start,
+                     Clock::time_point End);
     void flush(const clang::SourceManager&);
-    void printLibraryCounts(llvm::raw_ostream&);
+    void benchmark(const clang::SourceManager&);
+    std::string &getLog() { return Result.Log; }
+    TUResult takeResult();
   private:
-    std::set<clang::FileID> headerImportedFiles(const clang::SourceManager&);
-    std::map<clang::FileID, std::vector<clang::tooling::Range>> ImportRanges;
-    std::map<clang::FileID, std::vector<Import>> ImportMap;
-    std::set<clang::FileID> HeaderFiles;
-    std::map<llvm::StringRef, unsigned> LibraryCounts;
+    // what addImport needs to know about a decl, the import itself is
+    // only resolved the first time it is actually added
+    struct ResolvedImport {
+      clang::FileID DeclFile;
+      bool HasFilename;
+      llvm::Optional<Import> Imported;
+    };
+    typedef std::pair<const clang::Decl*, bool> TypeImport;
+
+    // the imports and import lines of one file, an import is only added
+    // once for each decl and forward declaration
+    struct FileState {
+      std::vector<Import> Imports;
+      llvm::DenseSet<std::pair<const clang::Decl*, unsigned>> Added;
+      std::vector<clang::tooling::Range> Ranges;
+    };
+
+    ResolvedImport &resolveImport(const clang::Decl*, const clang::SourceManager&,
+                                  bool isForwardDeclare);
+    void collectTypeImports(clang::QualType, bool isMainFile,
+                            const clang::SourceManager&, std::vector<TypeImport>&);
+    FileState &fileState(clang::FileID);
+    void collectCallbackStats();
+    bool hasModuleMap(llvm::StringRef FrameworkHeader, const clang::SourceManager&);
+    void flushIncludes(const clang::SourceManager&);
+    void addImportEdges(FileImports&, const std::vector<const Import*>&,
+                        const std::vector<Import>&, const clang::SourceManager&);
+    void addHeaderImports(FileImports&, const std::vector<Import>&,
+                          const clang::SourceManager&);
+    std::string headerKey(llvm::StringRef Path, clang::FileID,
+                          const std::vector<Import>&, const clang::SourceManager&) const;
+    llvm::DenseSet<clang::FileID> headerImportedFiles(const clang::SourceManager&);
+    void recordMicro(llvm::StringRef Name, unsigned Calls, Clock::time_point Start,
+                     Clock::time_point End);
+
+    // per translation unit tables, flush empties them but keeps
+    // their storage for the next translation unit
+    llvm::DenseMap<clang::FileID, unsigned> FileIndices;
+    std::vector<FileState> Files;
+    unsigned FilesUsed;
+    llvm::DenseSet<clang::FileID> HeaderFiles;
+    llvm::DenseSet<clang::FileID> ProjectFiles;
+    std::vector<std::pair<clang::FileID, const clang::FileEntry*>> Includes;
+
+    // per translation unit memos, indexed by isForwardDeclare and by
+    // whether the type is used in the main file
+    llvm::DenseMap<const clang::Decl*, ResolvedImport> ResolvedImports[2];
+    llvm::DenseMap<clang::QualType, std::vector<TypeImport>> TypeImports[2];
+    TUResult Result;
+    bool RecordDependencies;
+    bool ModulesEnabled;
+    HeaderCache *Headers;
+    std::set<std::string> Dependencies;
+    MatchOptions Options;
+    clang::ast_matchers::MatchFinder *Finder;
     CallExprCallback CallCallback;
     CastExprCallback CastCallback;
     CategoryCallback CategoryCallback;
@@ -51,7 +171,6 @@ namespace import_tidy {
     ProtocolCallback ProtoCallback;
     StripCallback StripCallback;
     FileCallbacks FileCallbacks;
-    clang::tooling::Replacements &Replacements;
     std::string Sysroot;
   };
 };
@@ -0,0 +1,367 @@
+#include "ImportPrefix.h"
+#include "ImportRunner.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace {
+
+  // arguments naming per file outputs, they don't change how a file parses
+  static unsigned outputArgumentCount(StringRef Arg) {
+    if (Arg == "-o" || Arg == "-MF" || Arg == "-MT" || Arg == "-MQ" ||
+        Arg == "--serialize-diagnostics")
+      return 2;
+    if (Arg == "-c" || Arg == "-MD" || Arg == "-MMD")
+      return 1;
+    return 0;
+  }
+
+  static std::string groupKey(const CompileCommand &Command, StringRef File) {
+    std::vector<std::string> Arguments;
+    if (!import_tidy::parseArguments(Command, File, Arguments))
+      return std::string();
+
+    std::string Key;
+    raw_string_ostream OS(Key);
+    OS << Command.Directory << '\0' << import_tidy::headerLanguage(File) << '\0';
+    for (auto &Arg : Arguments)
+      OS << Arg << '\0';
+    return OS.str();
+  }
+
+  static std::string absolutePath(StringRef Path, const SourceManager &SM) {
+    if (sys::path::is_absolute(Path))
+      return Path;
+
+    SmallString<256> Absolute(SM.getFileManager().getFileSystemOptions().WorkingDir);
+    sys::path::append(Absolute, Path);
+    return Absolute.str();
+  }
+
+  // records what went into the precompiled header, so translation units
+  // using it can still be invalidated by a change to any of its headers
+  class PrefixCallbacks : public PPCallbacks {
+  public:
+    PrefixCallbacks(const SourceManager &SM, PrefixHeader &Prefix,
+                    bool &HasUserFiles) :
+    SM(SM), Prefix(Prefix), HasUserFiles(HasUserFiles) { };
+
+    void FileChanged(SourceLocation Loc,
+                     FileChangeReason Reason,
+                     SrcMgr::CharacteristicKind FileType,
+                     FileID PrevFID) override {
+      if (Reason != EnterFile)
+        return;
+
+      auto FID = SM.getFileID(Loc);
+      auto *Entry = SM.getFileEntryForID(FID);
+      if (!Entry || FID == SM.getMainFileID())
+        return;
+
+      Prefix.Dependencies.push_back(absolutePath(Entry->getName(), SM));
+      if (FileType == SrcMgr::C_User)
+        HasUserFiles = true;
+    }
+
+  private:
+    const SourceManager &SM;
+    PrefixHeader &Prefix;
+    bool &HasUserFiles;
+  };
+
+  class PrefixAction : public GeneratePCHAction {
+  public:
+    PrefixAction(PrefixHeader &Prefix, bool &HasUserFiles) :
+    Prefix(Prefix), HasUserFiles(HasUserFiles) { };
+
+  protected:
+    bool BeginInvocation(CompilerInstance &CI) override {
+      CI.getFrontendOpts().OutputFile = Prefix.PCHPath;
+      return true;
+    }
+
+    bool BeginSourceFileAction(CompilerInstance &CI, StringRef Filename) override {
+      CI.getPreprocessor().addPPCallbacks(std::unique_ptr<PrefixCallbacks>(
+        new PrefixCallbacks(CI.getSourceManager(), Prefix, HasUserFiles)));
+      return GeneratePCHAction::BeginSourceFileAction(CI, Filename);
+    }
+
+  private:
+    PrefixHeader &Prefix;
+    bool &HasUserFiles;
+  };
+
+  class PrefixActionFactory : public FrontendActionFactory {
+  public:
+    PrefixActionFactory(PrefixHeader &Prefix, bool &HasUserFiles) :
+    Prefix(Prefix), HasUserFiles(HasUserFiles) { };
+
+    FrontendAction *create() override {
+      return new PrefixAction(Prefix, HasUserFiles);
+    }
+
+  private:
+    PrefixHeader &Prefix;
+    bool &HasUserFiles;
+  };
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - Helpers
+
+  StringRef headerLanguage(StringRef File) {
+    auto Extension = sys::path::extension(File);
+    if (Extension == ".m")
+      return "objective-c-header";
+    if (Extension == ".mm")
+      return "objective-c++-header";
+    if (Extension == ".c")
+      return "c-header";
+    return "c++-header";
+  }
+
+  bool parseArguments(const CompileCommand &Command, StringRef File,
+                      std::vector<std::string> &Arguments) {
+    auto &CommandLine = Command.CommandLine;
+    for (size_t I = 0; I < CommandLine.size(); I++) {
+      StringRef Arg = CommandLine[I];
+
+      // a prefix header of its own can't be combined with ours
+      if (Arg.startswith("-include"))
+        return false;
+
+      if (auto Count = outputArgumentCount(Arg)) {
+        I += Count - 1;
+        continue;
+      }
+      if (I > 0 && !Arg.startswith("-") &&
+          sys::path::filename(Arg) == sys::path::filename(File))
+        continue;
+
+      Arguments.push_back(Arg);
+    }
+    return true;
+  }
+
+  std::vector<std::string> leadingImports(StringRef Buffer) {
+    std::vector<std::string> Imports;
+    bool InComment = false;
+
+    while (!Buffer.empty()) {
+      StringRef Line;
+      std::tie(Line, Buffer) = Buffer.split('\n');
+      Line = Line.trim();
+
+      // skip comments, the file header usually comes first
+      if (InComment) {
+        auto End = Line.find("*/");
+        if (End == StringRef::npos)
+          continue;
+        InComment = false;
+        Line = Line.drop_front(End + 2).trim();
+      }
+      if (Line.startswith("/*")) {
+        auto End = Line.find("*/", 2);
+        if (End == StringRef::npos) {
+          InComment = true;
+          continue;
+        }
+        Line = Line.drop_front(End + 2).trim();
+      }
+      if (Line.empty() || Line.startswith("//"))
+        continue;
+
+      // anything else, including a quoted import, ends the prefix
+      auto End = Line.find('>');
+      if (!Line.startswith("#import <") || End == StringRef::npos)
+        break;
+      auto Rest = Line.drop_front(End + 1).trim();
+      if (!Rest.empty() && !Rest.startswith("//"))
+        break;
+
+      Imports.push_back(Line.substr(0, End + 1));
+    }
+    return Imports;
+  }
+
+#pragma mark - PrefixHeaders
+
+  PrefixHeaders::~PrefixHeaders() {
+    for (auto &Path : TemporaryFiles)
+      sys::fs::remove(Path);
+    if (!Directory.empty())
+      sys::fs::remove(Directory);
+  }
+
+  void PrefixHeaders::prepare(const CompilationDatabase &Compilations,
+                              ArrayRef<std::string> SourcePaths) {
+    struct Candidate {
+      std::string File;
+      CompileCommand Command;
+      std::vector<std::string> Imports;
+    };
+    std::map<std::string, std::vector<Candidate>> Groups;
+
+    for (auto &Source : SourcePaths) {
+      auto File = getAbsolutePath(Source);
+      auto Buffer = MemoryBuffer::getFile(File);
+      if (!Buffer)
+        continue;
+
+      auto Imports = leadingImports((*Buffer)->getBuffer());
+      if (Imports.empty())
+        continue;
+
+      for (auto &Command : Compilations.getCompileCommands(File)) {
+        auto Key = groupKey(Command, File);
+        if (!Key.empty())
+          Groups[Key].push_back(Candidate{File, Command, Imports});
+      }
+    }
+
+    for (auto &Group : Groups) {
+      // shrink the first file's imports to what the others share,
+      // files sharing nothing with it just don't use the prefix
+      auto &Candidates = Group.second;
+      auto Imports = Candidates.front().Imports;
+      for (auto &C : Candidates) {
+        size_t Shared = 0;
+        while (Shared < Imports.size() && Shared < C.Imports.size() &&
+               Imports[Shared] == C.Imports[Shared])
+          Shared++;
+        if (Shared > 0)
+          Imports.resize(Shared);
+      }
+
+      std::set<std::string> Sources;
+      for (auto &C : Candidates) {
+        if (C.Imports.size() >= Imports.size() &&
+            std::equal(Imports.begin(), Imports.end(), C.Imports.begin()))
+          Sources.insert(C.File);
+      }
+
+      // a single file gains nothing from precompiling its own imports
+      if (Sources.size() < 2)
+        continue;
+
+      auto &Prefix = Prefixes[Group.first];
+      Prefix.Index = Prefixes.size();
+      Prefix.Imports = std::move(Imports);
+      Prefix.Sources = std::move(Sources);
+      Prefix.File = Candidates.front().File;
+      Prefix.Command = Candidates.front().Command;
+    }
+
+    if (Prefixes.empty())
+      return;
+
+    SmallString<256> Path;
+    if (sys::fs::createUniqueDirectory("import-tidy-pch", Path)) {
+      errs() << "Couldn't create a directory for precompiled imports.\n";
+      Prefixes.clear();
+      return;
+    }
+    Directory = Path.str();
+  }
+
+  const PrefixHeader *PrefixHeaders::lookup(StringRef File,
+                                            const CompileCommand &Command) {
+    auto Found = Prefixes.find(groupKey(Command, File));
+    if (Found == Prefixes.end() || Found->second.Sources.count(File) == 0)
+      return nullptr;
+
+    auto &Prefix = Found->second;
+    std::call_once(Prefix.Built, [this, &Prefix] { build(Prefix); });
+    if (!Prefix.Succeeded)
+      return nullptr;
+
+    Uses++;
+    return &Prefix;
+  }
+
+  const PrefixHeader *PrefixHeaders::built(StringRef File,
+                                           const CompileCommand &Command) const {
+    // only called after a lookup for the same file, which built it
+    auto Found = Prefixes.find(groupKey(Command, File));
+    if (Found == Prefixes.end() || Found->second.Sources.count(File) == 0 ||
+        !Found->second.Succeeded)
+      return nullptr;
+    return &Found->second;
+  }
+
+  void PrefixHeaders::build(PrefixHeader &Prefix) {
+    SmallString<256> HeaderPath(Directory);
+    sys::path::append(HeaderPath, Twine(Prefix.Index) + "-prefix.h");
+    SmallString<256> PCHPath(Directory);
+    sys::path::append(PCHPath, Twine(Prefix.Index) + "-prefix.pch");
+    {
+      std::lock_guard<std::mutex> Lock(TemporaryFilesMutex);
+      TemporaryFiles.push_back(HeaderPath.str());
+      TemporaryFiles.push_back(PCHPath.str());
+    }
+
+    // the header has to stay on disk, loading the pch checks its inputs
+    std::error_code EC;
+    raw_fd_ostream OS(HeaderPath, EC, sys::fs::F_Text);
+    if (EC) {
+      Failed++;
+      return;
+    }
+    for (auto &Import : Prefix.Imports)
+      OS << Import << "\n";
+    OS.close();
+
+    CompileCommand Command;
+    Command.Directory = Prefix.Command.Directory;
+    parseArguments(Prefix.Command, Prefix.File, Command.CommandLine);
+    Command.CommandLine.push_back("-x");
+    Command.CommandLine.push_back(headerLanguage(Prefix.File));
+    Command.CommandLine.push_back(HeaderPath.str());
+    Prefix.PCHPath = PCHPath.str();
+
+    FileSystemOptions FileSystemOpts;
+    FileSystemOpts.WorkingDir = Command.Directory;
+    IntrusiveRefCntPtr<FileManager> Files(new FileManager(FileSystemOpts));
+    bool HasUserFiles = false;
+    PrefixActionFactory Factory(Prefix, HasUserFiles);
+    ToolInvocation Invocation(invocationCommandLine(Command), &Factory, Files.get());
+    if (!Invocation.run()) {
+      errs() << "Couldn't precompile the imports of " << Prefix.File << ".\n";
+      Failed++;
+      return;
+    }
+
+    // declarations in a pch are never traversed, so project headers
+    // have to be parsed by every translation unit for a correct result
+    if (HasUserFiles) {
+      Failed++;
+      return;
+    }
+
+    std::sort(Prefix.Dependencies.begin(), Prefix.Dependencies.end());
+    Prefix.Dependencies.erase(std::unique(Prefix.Dependencies.begin(),
+                                          Prefix.Dependencies.end()),
+                              Prefix.Dependencies.end());
+    Prefix.Succeeded = true;
+    Built++;
+  }
+
+  void PrefixHeaders::printStats(raw_ostream &OS) const {
+    OS << "Precompiled imports: " << Built << " built, " << Failed
+       << " not usable, used by " << Uses << " translation units\n";
+  }
+
+} // end namespace import_tidy
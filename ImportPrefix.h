@@ -0,0 +1,76 @@
+#ifndef __LLVM__ImportPrefix__
+#define __LLVM__ImportPrefix__
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // A precompiled header of the SDK imports that translation units with the
+  // same flags all start with. Units whose leading imports begin with the
+  // prefix load it with -include-pch instead of parsing those headers again;
+  // their own import lines still reach the preprocessor callbacks, the
+  // preprocessor just skips the files already imported.
+  struct PrefixHeader {
+    PrefixHeader() : Index(0), Succeeded(false) {};
+
+    size_t Index;
+    std::vector<std::string> Imports;
+    std::set<std::string> Sources;
+    std::string File;
+    clang::tooling::CompileCommand Command;
+
+    // filled in by the first translation unit that needs it
+    std::once_flag Built;
+    bool Succeeded;
+    std::string PCHPath;
+    std::vector<std::string> Dependencies;
+  };
+
+  class PrefixHeaders {
+  public:
+    PrefixHeaders() : Built(0), Failed(0), Uses(0) {};
+    ~PrefixHeaders();
+
+    void prepare(const clang::tooling::CompilationDatabase&,
+                 llvm::ArrayRef<std::string> SourcePaths);
+    const PrefixHeader *lookup(llvm::StringRef File,
+                               const clang::tooling::CompileCommand&);
+
+    // the prefix a lookup already built for File, without counting a use
+    // or building it
+    const PrefixHeader *built(llvm::StringRef File,
+                              const clang::tooling::CompileCommand&) const;
+    void printStats(llvm::raw_ostream&) const;
+  private:
+    void build(PrefixHeader&);
+    std::string Directory;
+    std::map<std::string, PrefixHeader> Prefixes;
+    std::vector<std::string> TemporaryFiles;
+    std::mutex TemporaryFilesMutex;
+    std::atomic<unsigned> Built;
+    std::atomic<unsigned> Failed;
+    std::atomic<unsigned> Uses;
+  };
+
+  // the #import <...> lines a source file starts with
+  std::vector<std::string> leadingImports(llvm::StringRef Buffer);
+
+  // the arguments that decide how a file parses, without the file itself
+  // or its outputs, so every file built with the same flags gets the same
+  // arguments; false if the command already uses a prefix header
+  bool parseArguments(const clang::tooling::CompileCommand&, llvm::StringRef File,
+                      std::vector<std::string> &Arguments);
+
+  // the -x language of a header imported by File
+  llvm::StringRef headerLanguage(llvm::StringRef File);
+}
+
+#endif /* defined(__LLVM__ImportPrefix__) */
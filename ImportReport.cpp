@@ -0,0 +1,268 @@
+#include "ImportReport.h"
+#include "Import.h"
+#include "ImportPrefix.h"
+#include "ImportRunner.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace {
+
+  // the same threshold printLibraryCounts uses, and a limit on how many
+  // headers are parsed for the report
+  static const unsigned kMinimumImports = 5;
+  static const unsigned kMeasuredHeaders = 50;
+  static const unsigned kReportedHeaders = 20;
+
+  // the translation units that included a header, the counts are keyed
+  // by absolute path and import names can be relative to the source
+  static unsigned includingUnits(const std::map<std::string, unsigned> &Units,
+                                 const CompileCommand &Command, StringRef Header) {
+    SmallString<256> Path(Header);
+    if (sys::path::is_relative(Path)) {
+      Path = Command.Directory;
+      sys::path::append(Path, Header);
+    }
+    auto Found = Units.find(Path.str());
+    return Found != Units.end() ? Found->second : 0;
+  }
+
+  class ByteCounter : public PPCallbacks {
+  public:
+    ByteCounter(const SourceManager &SM, uint64_t &Bytes) : SM(SM), Bytes(Bytes) {};
+
+    void FileChanged(SourceLocation Loc,
+                     FileChangeReason Reason,
+                     SrcMgr::CharacteristicKind FileType,
+                     FileID PrevFID) override {
+      if (Reason != EnterFile)
+        return;
+
+      auto FID = SM.getFileID(Loc);
+      auto *Entry = SM.getFileEntryForID(FID);
+      if (Entry && FID != SM.getMainFileID())
+        Bytes += Entry->getSize();
+    }
+
+  private:
+    const SourceManager &SM;
+    uint64_t &Bytes;
+  };
+
+  // preprocesses the main file and counts the tokens that come out
+  class CostAction : public PreprocessorFrontendAction {
+  public:
+    CostAction(uint64_t &Bytes, uint64_t &Tokens) : Bytes(Bytes), Tokens(Tokens) {};
+
+  protected:
+    bool BeginSourceFileAction(CompilerInstance &CI, StringRef Filename) override {
+      CI.getPreprocessor().addPPCallbacks(std::unique_ptr<ByteCounter>(
+        new ByteCounter(CI.getSourceManager(), Bytes)));
+      return true;
+    }
+
+    void ExecuteAction() override {
+      auto &PP = getCompilerInstance().getPreprocessor();
+      PP.EnterMainSourceFile();
+      Token Tok;
+      do {
+        PP.Lex(Tok);
+        Tokens++;
+      } while (Tok.isNot(tok::eof));
+    }
+
+  private:
+    uint64_t &Bytes;
+    uint64_t &Tokens;
+  };
+
+  // counts errors without printing them, headers measured on their own
+  // are not always self contained
+  class SilentDiagnostics : public DiagnosticConsumer {
+  };
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - PrefixReport
+
+  void PrefixReport::measure(const std::map<std::string, unsigned> &LibraryCounts,
+                             const std::map<std::string, unsigned> &FileCounts,
+                             const std::map<std::string, unsigned> &IncludingUnits) {
+    Headers.clear();
+
+    // the flags of the first source without a prefix header of its own
+    CompileCommand Command;
+    std::string File;
+    for (auto &Source : SourcePaths) {
+      auto Path = getAbsolutePath(Source);
+      std::vector<std::string> Arguments;
+      for (auto &C : Compilations.getCompileCommands(Path)) {
+        if (File.empty() && parseArguments(C, Path, Arguments)) {
+          Command = C;
+          File = Path;
+        }
+      }
+      if (!File.empty())
+        break;
+    }
+    if (File.empty()) {
+      errs() << "No compile command to measure headers with.\n";
+      return;
+    }
+
+    for (auto &Pair : LibraryCounts) {
+      if (Pair.second < kMinimumImports)
+        continue;
+      HeaderCost Cost;
+      Cost.Path = Pair.first;
+      Cost.Line = "#import <" + libraryIncludeName(Pair.first) + ">";
+      Cost.IsLibrary = true;
+      Cost.Imports = Pair.second;
+      Cost.Units = includingUnits(IncludingUnits, Command, Pair.first);
+      Headers.push_back(std::move(Cost));
+    }
+    for (auto &Pair : FileCounts) {
+      if (Pair.second < kMinimumImports)
+        continue;
+      HeaderCost Cost;
+      Cost.Path = Pair.first;
+      Cost.Line = "#import \"" + Pair.first + "\"";
+      Cost.Imports = Pair.second;
+      Cost.Units = includingUnits(IncludingUnits, Command, Pair.first);
+      Headers.push_back(std::move(Cost));
+    }
+
+    std::sort(Headers.begin(), Headers.end(),
+              [](const HeaderCost &L, const HeaderCost &R) {
+                return L.Units > R.Units;
+              });
+    if (Headers.size() > kMeasuredHeaders)
+      Headers.resize(kMeasuredHeaders);
+
+    // what every translation unit pays regardless of its imports
+    HeaderCost Empty;
+    if (!measureHeader(Command, File, "", Empty)) {
+      errs() << "Couldn't parse an empty file with the flags of " << File << ".\n";
+      Headers.clear();
+      return;
+    }
+    BaselineTime = Empty.ParseTime;
+
+    std::vector<HeaderCost> Measured;
+    for (auto &Cost : Headers) {
+      if (!measureHeader(Command, File, Cost.Line + "\n", Cost)) {
+        errs() << "Couldn't parse " << Cost.Path << " on its own, skipping it.\n";
+        continue;
+      }
+      Cost.ParseTime = std::max(0.0, Cost.ParseTime - BaselineTime);
+      Measured.push_back(std::move(Cost));
+    }
+
+    std::sort(Measured.begin(), Measured.end(),
+              [](const HeaderCost &L, const HeaderCost &R) {
+                return L.savings() > R.savings();
+              });
+    Headers = std::move(Measured);
+  }
+
+  bool PrefixReport::measureHeader(const CompileCommand &Command, StringRef File,
+                                   StringRef Content, HeaderCost &Cost) {
+    SmallString<256> Path(Command.Directory);
+    sys::path::append(Path, Twine("import-tidy-report") + sys::path::extension(File));
+
+    CompileCommand Snippet;
+    Snippet.Directory = Command.Directory;
+    parseArguments(Command, File, Snippet.CommandLine);
+    Snippet.CommandLine.push_back("-fsyntax-only");
+    Snippet.CommandLine.push_back(Path.str());
+
+    FileSystemOptions FileSystemOpts;
+    FileSystemOpts.WorkingDir = Command.Directory;
+    SilentDiagnostics Diagnostics;
+
+    // preprocess once for the size, then parse once for the time
+    {
+      IntrusiveRefCntPtr<FileManager> Files(new FileManager(FileSystemOpts));
+      ToolInvocation Invocation(invocationCommandLine(Snippet),
+                                new CostAction(Cost.Bytes, Cost.Tokens), Files.get());
+      Invocation.mapVirtualFile(Path, Content);
+      Invocation.setDiagnosticConsumer(&Diagnostics);
+      if (!Invocation.run() || Diagnostics.getNumErrors() > 0)
+        return false;
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+    IntrusiveRefCntPtr<FileManager> Files(new FileManager(FileSystemOpts));
+    ToolInvocation Invocation(invocationCommandLine(Snippet),
+                              new SyntaxOnlyAction, Files.get());
+    Invocation.mapVirtualFile(Path, Content);
+    Invocation.setDiagnosticConsumer(&Diagnostics);
+    if (!Invocation.run() || Diagnostics.getNumErrors() > 0)
+      return false;
+
+    std::chrono::duration<double, std::milli> Time =
+      std::chrono::steady_clock::now() - Start;
+    Cost.ParseTime = Time.count();
+    return true;
+  }
+
+  void PrefixReport::print(raw_ostream &OS) const {
+    if (Headers.empty())
+      return;
+
+    OS << "\n\n";
+    OS << "------------------------------------------------" << "\n";
+    OS << "Prefix header candidates by estimated time saved" << "\n";
+    OS << "------------------------------------------------" << "\n";
+    OS << "(an empty file takes " << format("%.2f", BaselineTime)
+       << " ms to parse, header times are on top of that)\n";
+
+    double Total = 0;
+    for (size_t I = 0; I < Headers.size() && I < kReportedHeaders; I++) {
+      auto &Cost = Headers[I];
+      OS << Cost.Line << " : " << Cost.Imports << " imports in "
+         << Cost.Units << " translation units, "
+         << format("%.1f", Cost.Bytes / 1024.0) << " KB, " << Cost.Tokens
+         << " tokens, " << format("%.2f", Cost.ParseTime) << " ms, saves ~"
+         << format("%.0f", Cost.savings()) << " ms\n";
+      if (Cost.IsLibrary)
+        Total += Cost.savings();
+    }
+    OS << "A prefix header of the library headers above saves ~"
+       << format("%.0f", Total) << " ms per build\n";
+  }
+
+  bool PrefixReport::writePrefixHeader(StringRef Path) const {
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::F_Text);
+    if (EC)
+      return false;
+
+    // project headers change too often to be worth precompiling
+    OS << "// Generated by import-tidy -prefix-report, the library headers\n"
+       << "// whose precompilation saves the most parse time.\n\n";
+    for (size_t I = 0; I < Headers.size() && I < kReportedHeaders; I++) {
+      if (Headers[I].IsLibrary && Headers[I].savings() > 0)
+        OS << Headers[I].Line << "\n";
+    }
+
+    OS.close();
+    return !OS.has_error();
+  }
+
+} // end namespace import_tidy
@@ -0,0 +1,62 @@
+#ifndef __LLVM__ImportReport__
+#define __LLVM__ImportReport__
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // Ranks the headers imported most often in a run as candidates for a
+  // shared prefix header. Each one is preprocessed and parsed on its own
+  // with the flags of the first source, which gives its byte and token
+  // cost and the time a translation unit spends on it. Every translation
+  // unit but one that includes a header precompiled into the prefix saves
+  // about that time, however many of its files import it.
+  class PrefixReport {
+  public:
+    PrefixReport(const clang::tooling::CompilationDatabase &Compilations,
+                 llvm::ArrayRef<std::string> SourcePaths) :
+      Compilations(Compilations), SourcePaths(SourcePaths), BaselineTime(0) {};
+
+    void measure(const std::map<std::string, unsigned> &LibraryCounts,
+                 const std::map<std::string, unsigned> &FileCounts,
+                 const std::map<std::string, unsigned> &IncludingUnits);
+    void print(llvm::raw_ostream&) const;
+    bool writePrefixHeader(llvm::StringRef Path) const;
+  private:
+    struct HeaderCost {
+      HeaderCost() :
+        IsLibrary(false), Imports(0), Units(0), Bytes(0), Tokens(0),
+        ParseTime(0) {};
+
+      std::string Path;
+      std::string Line;
+      bool IsLibrary;
+      unsigned Imports;
+
+      // translation units that include the header, a unit parses it once
+      // however many import lines name it
+      unsigned Units;
+      uint64_t Bytes;
+      uint64_t Tokens;
+
+      // milliseconds, without what parsing an empty file takes
+      double ParseTime;
+      double savings() const {
+        return Units > 1 ? (Units - 1) * ParseTime : 0;
+      }
+    };
+    bool measureHeader(const clang::tooling::CompileCommand&, llvm::StringRef File,
+                       llvm::StringRef Content, HeaderCost&);
+    const clang::tooling::CompilationDatabase &Compilations;
+    std::vector<std::string> SourcePaths;
+    std::vector<HeaderCost> Headers;
+    double BaselineTime;
+  };
+}
+
+#endif /* defined(__LLVM__ImportReport__) */
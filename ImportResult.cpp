@@ -0,0 +1,329 @@
+#include "ImportResult.h"
+
+using namespace llvm;
+using namespace clang::tooling;
+
+namespace import_tidy {
+
+#pragma mark - Fields
+
+  void writeString(raw_ostream &OS, StringRef S) {
+    OS << S.size() << ':' << S << '\n';
+  }
+
+  void writeNumber(raw_ostream &OS, uint64_t N) {
+    OS << N << '\n';
+  }
+
+  bool readString(StringRef &Buffer, std::string &S) {
+    auto Colon = Buffer.find(':');
+    uint64_t Size;
+    if (Colon == StringRef::npos || Buffer.substr(0, Colon).getAsInteger(10, Size))
+      return false;
+
+    Buffer = Buffer.drop_front(Colon + 1);
+    if (Buffer.size() <= Size || Buffer[Size] != '\n')
+      return false;
+
+    S = Buffer.substr(0, Size).str();
+    Buffer = Buffer.drop_front(Size + 1);
+    return true;
+  }
+
+  bool readNumber(StringRef &Buffer, uint64_t &N) {
+    auto End = Buffer.find('\n');
+    if (End == StringRef::npos || Buffer.substr(0, End).getAsInteger(10, N))
+      return false;
+
+    Buffer = Buffer.drop_front(End + 1);
+    return true;
+  }
+
+#pragma mark - Results
+
+  void writeResult(raw_ostream &OS, const TUResult &Result) {
+    writeString(OS, Result.Log);
+
+    writeNumber(OS, Result.Files.size());
+    for (auto &File : Result.Files) {
+      writeString(OS, File.Path);
+      writeString(OS, File.Block);
+      writeNumber(OS, File.Replacements.size());
+      for (auto &R : File.Replacements) {
+        writeString(OS, R.getFilePath());
+        writeNumber(OS, R.getOffset());
+        writeNumber(OS, R.getLength());
+        writeString(OS, R.getReplacementText());
+      }
+
+      writeNumber(OS, File.IsHeader ? 1 : 0);
+      writeNumber(OS, File.ModulesEnabled ? 1 : 0);
+      writeNumber(OS, File.Imports.size());
+      for (auto &Import : File.Imports) {
+        writeNumber(OS, static_cast<uint64_t>(Import.Type));
+        writeString(OS, Import.Name);
+        writeString(OS, Import.Line);
+        writeString(OS, Import.File);
+        writeString(OS, Import.LibraryName);
+        writeString(OS, Import.LibraryLine);
+      }
+      writeNumber(OS, File.Superclasses.size());
+      for (auto &Path : File.Superclasses)
+        writeString(OS, Path);
+      writeNumber(OS, File.ImportedFiles.size());
+      for (auto &Path : File.ImportedFiles)
+        writeString(OS, Path);
+      writeNumber(OS, File.Edges.size());
+      for (auto &Edge : File.Edges) {
+        writeNumber(OS, static_cast<uint64_t>(Edge.Type));
+        writeString(OS, Edge.To);
+        writeString(OS, Edge.Name);
+        writeNumber(OS, Edge.Decls.size());
+        for (auto &Decl : Edge.Decls)
+          writeString(OS, Decl);
+      }
+    }
+
+    for (auto *Counts : { &Result.LibraryCounts, &Result.FileCounts }) {
+      writeNumber(OS, Counts->size());
+      for (auto &Pair : *Counts) {
+        writeString(OS, Pair.first);
+        writeNumber(OS, Pair.second);
+      }
+    }
+
+    writeNumber(OS, Result.Dependencies.size());
+    for (auto &Path : Result.Dependencies)
+      writeString(OS, Path);
+
+    writeNumber(OS, Result.Includes.size());
+    for (auto &Edge : Result.Includes) {
+      writeString(OS, Edge.From);
+      writeString(OS, Edge.To);
+      writeNumber(OS, Edge.Size);
+      writeNumber(OS, Edge.IsSystem ? 1 : 0);
+    }
+  }
+
+  bool readResult(StringRef &Buffer, TUResult &Result) {
+    uint64_t Count;
+    if (!readString(Buffer, Result.Log) || !readNumber(Buffer, Count))
+      return false;
+
+    Result.Files.resize(Count);
+    for (auto &File : Result.Files) {
+      uint64_t Replacements;
+      if (!readString(Buffer, File.Path) ||
+          !readString(Buffer, File.Block) ||
+          !readNumber(Buffer, Replacements))
+        return false;
+
+      for (uint64_t I = 0; I < Replacements; I++) {
+        std::string Path, Text;
+        uint64_t Offset, Length;
+        if (!readString(Buffer, Path) ||
+            !readNumber(Buffer, Offset) ||
+            !readNumber(Buffer, Length) ||
+            !readString(Buffer, Text))
+          return false;
+        File.Replacements.push_back(Replacement(Path, Offset, Length, Text));
+      }
+
+      uint64_t IsHeader, ModulesEnabled, Imports, Superclasses;
+      if (!readNumber(Buffer, IsHeader) || !readNumber(Buffer, ModulesEnabled) ||
+          !readNumber(Buffer, Imports))
+        return false;
+      File.IsHeader = IsHeader != 0;
+      File.ModulesEnabled = ModulesEnabled != 0;
+      File.Imports.resize(Imports);
+      for (auto &Import : File.Imports) {
+        uint64_t Type;
+        if (!readNumber(Buffer, Type) ||
+            Type > static_cast<uint64_t>(ImportType::ForwardDeclareProtocol) ||
+            !readString(Buffer, Import.Name) ||
+            !readString(Buffer, Import.Line) ||
+            !readString(Buffer, Import.File) ||
+            !readString(Buffer, Import.LibraryName) ||
+            !readString(Buffer, Import.LibraryLine))
+          return false;
+        Import.Type = static_cast<ImportType>(Type);
+      }
+
+      if (!readNumber(Buffer, Superclasses))
+        return false;
+      File.Superclasses.resize(Superclasses);
+      for (auto &Path : File.Superclasses)
+        if (!readString(Buffer, Path))
+          return false;
+
+      uint64_t ImportedFiles;
+      if (!readNumber(Buffer, ImportedFiles))
+        return false;
+      File.ImportedFiles.resize(ImportedFiles);
+      for (auto &Path : File.ImportedFiles)
+        if (!readString(Buffer, Path))
+          return false;
+
+      uint64_t Edges;
+      if (!readNumber(Buffer, Edges))
+        return false;
+      File.Edges.resize(Edges);
+      for (auto &Edge : File.Edges) {
+        uint64_t Type, Decls;
+        if (!readNumber(Buffer, Type) ||
+            Type > static_cast<uint64_t>(ImportType::ForwardDeclareProtocol) ||
+            !readString(Buffer, Edge.To) ||
+            !readString(Buffer, Edge.Name) ||
+            !readNumber(Buffer, Decls))
+          return false;
+        Edge.Type = static_cast<ImportType>(Type);
+        Edge.Decls.resize(Decls);
+        for (auto &Decl : Edge.Decls)
+          if (!readString(Buffer, Decl))
+            return false;
+      }
+    }
+
+    for (auto *Counts : { &Result.LibraryCounts, &Result.FileCounts }) {
+      if (!readNumber(Buffer, Count))
+        return false;
+      for (uint64_t I = 0; I < Count; I++) {
+        std::string Name;
+        uint64_t N;
+        if (!readString(Buffer, Name) || !readNumber(Buffer, N))
+          return false;
+        (*Counts)[Name] = N;
+      }
+    }
+
+    if (!readNumber(Buffer, Count))
+      return false;
+    Result.Dependencies.resize(Count);
+    for (auto &Path : Result.Dependencies)
+      if (!readString(Buffer, Path))
+        return false;
+
+    if (!readNumber(Buffer, Count))
+      return false;
+    Result.Includes.resize(Count);
+    for (auto &Edge : Result.Includes) {
+      uint64_t IsSystem;
+      if (!readString(Buffer, Edge.From) || !readString(Buffer, Edge.To) ||
+          !readNumber(Buffer, Edge.Size) || !readNumber(Buffer, IsSystem))
+        return false;
+      Edge.IsSystem = IsSystem != 0;
+    }
+
+    return true;
+  }
+
+#pragma mark - HeaderImports
+
+  void HeaderImports::add(const FileImports &File) {
+    auto Inserted = Indices.insert(std::make_pair(File.Path, Headers.size()));
+    if (Inserted.second) {
+      Header H;
+      H.Path = File.Path;
+      H.Replacements = File.Replacements;
+      Headers.push_back(std::move(H));
+    }
+
+    auto &H = Headers[Inserted.first->second];
+    H.ModulesEnabled &= File.ModulesEnabled;
+    H.Imports.insert(File.Imports.begin(), File.Imports.end());
+    H.Superclasses.insert(File.Superclasses.begin(), File.Superclasses.end());
+    for (auto &Edge : File.Edges)
+      H.Decls[std::make_pair(Edge.Type, Edge.Name)].insert(Edge.Decls.begin(),
+                                                           Edge.Decls.end());
+  }
+
+  std::string HeaderImports::block(const Header &H,
+                                   std::vector<std::string> &Imported,
+                                   std::vector<ImportEdge> &Edges) const {
+    // the same rules as sortedUniqueImports, applied to the union
+    std::set<std::string> ImportedFiles;
+    for (auto &Import : H.Imports) {
+      if (Import.Type != ImportType::ForwardDeclareClass &&
+          Import.Type != ImportType::ForwardDeclareProtocol)
+        ImportedFiles.insert(Import.File);
+    }
+
+    std::string Block;
+    raw_string_ostream OS(Block);
+    const HeaderImport *Previous = nullptr;
+    for (auto &Import : H.Imports) {
+      bool IsForwardDeclare = Import.Type == ImportType::ForwardDeclareClass ||
+                              Import.Type == ImportType::ForwardDeclareProtocol;
+      if (H.Superclasses.count(Import.File) > 0 ||
+          (IsForwardDeclare && ImportedFiles.count(Import.File) > 0))
+        continue;
+
+      // the set is ordered by type and name first, so equal lines are adjacent
+      if (Previous && Previous->Type == Import.Type && Previous->Name == Import.Name)
+        continue;
+
+      OS << Import.Line << '\n';
+      if (!IsForwardDeclare)
+        Imported.push_back(Import.File);
+      Previous = &Import;
+
+      auto Found = H.Decls.find(std::make_pair(Import.Type, Import.Name));
+      if (Found != H.Decls.end()) {
+        ImportEdge Edge;
+        Edge.Type = Import.Type;
+        Edge.To = Import.File;
+        Edge.Name = Import.Name;
+        Edge.Decls.assign(Found->second.begin(), Found->second.end());
+        Edges.push_back(std::move(Edge));
+      }
+    }
+    OS << '\n';
+    return OS.str();
+  }
+
+  void HeaderImports::removeModuleImports(Header &H) const {
+    // a unit without modules can't parse @import, use the library import
+    // the module stood for, which merges with that unit's own
+    std::set<HeaderImport> Imports;
+    for (auto Import : H.Imports) {
+      if (Import.Type == ImportType::Module) {
+        auto Found = H.Decls.find(std::make_pair(Import.Type, Import.Name));
+        if (Found != H.Decls.end()) {
+          auto Decls = std::move(Found->second);
+          H.Decls.erase(Found);
+          H.Decls[std::make_pair(ImportType::Library, Import.LibraryName)]
+            .insert(Decls.begin(), Decls.end());
+        }
+        Import.Type = ImportType::Library;
+        Import.Name = Import.LibraryName;
+        Import.Line = Import.LibraryLine;
+        Import.LibraryName.clear();
+        Import.LibraryLine.clear();
+      }
+      Imports.insert(std::move(Import));
+    }
+    H.Imports.swap(Imports);
+  }
+
+  void HeaderImports::finish(std::vector<FileImports> &Files) {
+    for (auto &H : Headers) {
+      if (!H.ModulesEnabled)
+        removeModuleImports(H);
+
+      FileImports File;
+      File.Path = H.Path;
+      File.IsHeader = true;
+      File.Block = block(H, File.ImportedFiles, File.Edges);
+      for (size_t I = 0; I < H.Replacements.size(); I++) {
+        auto &R = H.Replacements[I];
+        File.Replacements.push_back(Replacement(R.getFilePath(), R.getOffset(),
+                                                R.getLength(),
+                                                I == 0 ? File.Block : ""));
+      }
+      Files.push_back(std::move(File));
+    }
+    Indices.clear();
+    Headers.clear();
+  }
+
+} // end namespace import_tidy
@@ -0,0 +1,184 @@
+#ifndef __LLVM__ImportResult__
+#define __LLVM__ImportResult__
+
+#include "clang/Tooling/Refactoring.h"
+#include "llvm/Support/raw_ostream.h"
+#include "Import.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // an import a translation unit wants in a header, File is the path of
+  // the file it names or declares, so imports from different translation
+  // units can be compared. A module import also keeps the library import
+  // it replaced, which the header gets if any unit has no modules
+  struct HeaderImport {
+    ImportType Type;
+    std::string Name;
+    std::string Line;
+    std::string File;
+    std::string LibraryName;
+    std::string LibraryLine;
+
+    bool operator<(const HeaderImport &RHS) const {
+      if (Type != RHS.Type)
+        return Type < RHS.Type;
+      if (Name != RHS.Name)
+        return Name < RHS.Name;
+      return File < RHS.File;
+    }
+  };
+
+  // an #import or #include seen while parsing, To is a system file when
+  // it was never entered as a user file
+  struct IncludeEdge {
+    IncludeEdge() : Size(0), IsSystem(false) {};
+
+    std::string From;
+    std::string To;
+    uint64_t Size;
+    bool IsSystem;
+  };
+
+  // an import the block of a file has, with the names of the decls that
+  // needed it
+  struct ImportEdge {
+    ImportType Type;
+    std::string To;
+    std::string Name;
+    std::vector<std::string> Decls;
+  };
+
+  // the tidied import block of a single file and the edits to apply it,
+  // headers also keep what the block was made of, since the block written
+  // to a header is the union of every translation unit that tidied it
+  struct FileImports {
+    FileImports() : IsHeader(false), ModulesEnabled(false) {};
+
+    std::string Path;
+    std::string Block;
+    std::vector<clang::tooling::Replacement> Replacements;
+    bool IsHeader;
+
+    // whether the translation unit was compiled with -fmodules, a header
+    // only gets @import lines if every unit that tidies it was
+    bool ModulesEnabled;
+    std::vector<HeaderImport> Imports;
+    std::vector<std::string> Superclasses;
+
+    // the files the block imports, forward declarations aside
+    std::vector<std::string> ImportedFiles;
+
+    // every import of the block, for -emit-graph
+    std::vector<ImportEdge> Edges;
+  };
+
+  // the imports of every translation unit that tidied a header, the
+  // replacement ranges come from the first one in source order
+  class HeaderImports {
+  public:
+    void add(const FileImports&);
+    void finish(std::vector<FileImports>&);
+  private:
+    struct Header {
+      Header() : ModulesEnabled(true) {};
+
+      std::string Path;
+      std::vector<clang::tooling::Replacement> Replacements;
+      std::set<HeaderImport> Imports;
+      std::set<std::string> Superclasses;
+      bool ModulesEnabled;
+
+      // the decls that needed each import, by type and name, for -emit-graph
+      std::map<std::pair<ImportType, std::string>, std::set<std::string>> Decls;
+    };
+    void removeModuleImports(Header&) const;
+    std::string block(const Header&, std::vector<std::string> &ImportedFiles,
+                      std::vector<ImportEdge> &Edges) const;
+    std::map<std::string, size_t> Indices;
+    std::vector<Header> Headers;
+  };
+
+  // how often a per translation unit memo table was hit
+  struct MemoStats {
+    MemoStats() : Hits(0), Misses(0) {};
+
+    unsigned Hits;
+    unsigned Misses;
+  };
+
+  // how many nodes a match callback handled and for how many microseconds
+  struct CallbackStats {
+    CallbackStats() : Matches(0), Time(0) {};
+
+    unsigned Matches;
+    double Time;
+  };
+
+  // how often -micro-bench-iterations called a function and the total
+  // microseconds it took
+  struct MicroStats {
+    MicroStats() : Calls(0), Time(0) {};
+
+    unsigned Calls;
+    double Time;
+  };
+
+  // a phase of the run, times are in microseconds and the start is
+  // relative to the epoch of std::chrono::steady_clock
+  struct TraceEvent {
+    std::string Name;
+    double Start;
+    double Duration;
+  };
+
+  // measurements of a translation unit, never persisted
+  struct TUStats {
+    TUStats() :
+      ParseTime(0), MatchTime(0), ResolveTime(0), Worker(0), PeakRSS(0),
+      Cached(false) {};
+
+    // milliseconds
+    double ParseTime;
+    double MatchTime;
+    MemoStats ImportMemo;
+    MemoStats TypeMemo;
+
+    // only recorded when stats are collected, ResolveTime is the total
+    // microseconds spent building imports for decls
+    std::vector<TraceEvent> Events;
+    double ResolveTime;
+    std::map<std::string, CallbackStats> Callbacks;
+    std::map<std::string, MicroStats> Micro;
+    unsigned Worker;
+    uint64_t PeakRSS;
+    bool Cached;
+  };
+
+  // everything one translation unit contributes to a run, merged
+  // in source order so parallel runs match serial ones
+  struct TUResult {
+    std::string Log;
+    std::vector<FileImports> Files;
+    std::map<std::string, unsigned> LibraryCounts;
+    std::map<std::string, unsigned> FileCounts;
+    std::vector<std::string> Dependencies;
+    std::vector<IncludeEdge> Includes;
+    TUStats Stats;
+  };
+
+  // a line based format of length prefixed strings, so any bytes in
+  // import blocks survive a round trip through the on-disk caches
+  void writeString(llvm::raw_ostream&, llvm::StringRef);
+  void writeNumber(llvm::raw_ostream&, uint64_t);
+  bool readString(llvm::StringRef &Buffer, std::string&);
+  bool readNumber(llvm::StringRef &Buffer, uint64_t&);
+
+  void writeResult(llvm::raw_ostream&, const TUResult&);
+  bool readResult(llvm::StringRef &Buffer, TUResult&);
+}
+
+#endif /* defined(__LLVM__ImportResult__) */
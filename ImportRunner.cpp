@@ -0,0 +1,737 @@
+#include "ImportRunner.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/ReplacementsYaml.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <set>
+#include <thread>
+
+using namespace clang;
+using namespace clang::ast_matchers;
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace {
+
+  // the driver finds the builtin headers relative to the executable,
+  // this just needs to be some symbol in the binary
+  static int StaticSymbol;
+
+  static std::string mainExecutable() {
+    return sys::fs::getMainExecutable("import-tidy", &StaticSymbol);
+  }
+
+  // bump whenever the shard format changes
+  static const uint64_t kShardVersion = 7;
+  static const char kShardMagic[] = "import-tidy-shard";
+
+  // the SDK a command compiles against, its headers don't change between
+  // the runs of a server
+  static std::string commandSysroot(const tooling::CompileCommand &Command) {
+    auto &CommandLine = Command.CommandLine;
+    StringRef Sysroot;
+    for (size_t I = 0; I < CommandLine.size() && Sysroot.empty(); I++) {
+      StringRef Arg = CommandLine[I];
+      if ((Arg == "-isysroot" || Arg == "--sysroot") && I + 1 < CommandLine.size())
+        Sysroot = CommandLine[I + 1];
+      else if (Arg.startswith("--sysroot="))
+        Sysroot = Arg.substr(strlen("--sysroot="));
+      else if (Arg.startswith("-isysroot"))
+        Sysroot = Arg.substr(strlen("-isysroot"));
+    }
+    if (Sysroot.empty())
+      return std::string();
+
+    SmallString<256> Path(Sysroot);
+    if (sys::path::is_relative(Path)) {
+      Path = Command.Directory;
+      sys::path::append(Path, Sysroot);
+    }
+
+    // a sysroot of / would keep the project files as well
+    if (sys::path::relative_path(Path).empty())
+      return std::string();
+    return Path.str();
+  }
+
+  static void printMemoStats(raw_ostream &OS, StringRef Name,
+                             const import_tidy::MemoStats &Stats) {
+    unsigned Total = Stats.Hits + Stats.Misses;
+    OS << Name << ": " << Stats.Hits << " hits, " << Stats.Misses << " misses";
+    if (Total > 0)
+      OS << " (" << (uint64_t(Stats.Hits) * 100 / Total) << "% hit rate)";
+    OS << "\n";
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - ImportRunner
+
+  void ImportRunner::setCacheDirectory(StringRef Directory) {
+    Cache.reset(new ResultCache(Directory));
+
+    // the index is only as good as the last run that saved it, a missing
+    // or stale one just makes every source look affected
+    SmallString<256> Path(Directory);
+    sys::path::append(Path, "include-index");
+    Index.reset(new IncludeIndex(Path));
+    Index->load();
+  }
+
+  std::vector<std::string>
+  ImportRunner::affectedSources(ArrayRef<std::string> ChangedFiles) const {
+    std::vector<std::string> Paths;
+    for (auto &Source : SourcePaths)
+      Paths.push_back(getAbsolutePath(Source));
+    if (!Index)
+      return Paths;
+    return Index->affectedSources(Paths, ChangedFiles);
+  }
+
+  void ImportRunner::prepare() {
+    // the precompiled headers themselves are built by the first
+    // translation unit that needs one, and kept for later runs
+    if (Prefixes && !Prepared)
+      Prefixes->prepare(Compilations, SourcePaths);
+    Prepared = true;
+  }
+
+  int ImportRunner::run(raw_ostream &OS) {
+    prepare();
+
+    // a runner can be run again on other sources, start from nothing
+    Replacements.clear();
+    TidiedFiles.clear();
+    LibraryCounts.clear();
+    FileCounts.clear();
+    IncludingUnits.clear();
+    TidiedHeaders.clear();
+    Graph.reset(Options.IncludeGraph ? new ImportGraph() : nullptr);
+    ImportMemo = MemoStats();
+    TypeMemo = MemoStats();
+    if (Cache)
+      Cache->clearContentHashes();
+    startWriter();
+
+    // every translation unit stats and reads the same headers, share
+    // them and keep them for the next run, which checks what changed
+    if (!FileSystem)
+      FileSystem = new CachingFileSystem(vfs::getRealFileSystem());
+    else
+      FileSystem->revalidate();
+    if (!ModuleCachePath.empty()) {
+      SmallString<256> Path(ModuleCachePath);
+      sys::fs::make_absolute(Path);
+      ModuleCachePath = Path.str();
+      FileSystem->addUncachedDirectory(ModuleCachePath);
+      BuildSession = std::time(nullptr);
+    }
+
+    Sources.clear();
+    for (size_t I = ShardIndex; I < SourcePaths.size(); I += ShardCount)
+      Sources.push_back(I);
+    ShardResults.clear();
+    RunStarted = std::time(nullptr);
+    if (Prefilter && Index && !Sharded)
+      skipTidySources(OS);
+
+    Results.clear();
+    Results.resize(SourcePaths.size());
+    Finished.assign(SourcePaths.size(), false);
+    NextSource = 0;
+    ProcessingFailed = false;
+    StopScheduling = false;
+    CheckedSources = 0;
+    UntidyFiles.clear();
+    if (Options.CollectStats)
+      Stats.reset(new ImportStats());
+
+    auto Workers = std::min<size_t>(std::max(1u, Jobs), Sources.size());
+    std::vector<std::thread> Threads;
+    for (unsigned I = 0; I < Workers; I++)
+      Threads.push_back(std::thread([this, I] { runWorker(I); }));
+
+    // merge in source order as results arrive so the output is
+    // identical whatever the number of jobs
+    for (auto I : Sources) {
+      std::unique_lock<std::mutex> Lock(ResultsMutex);
+      ResultReady.wait(Lock, [this, I] { return Finished[I]; });
+      auto Result = std::move(Results[I]);
+      Lock.unlock();
+
+      mergeResult(SourcePaths[I], Result, OS);
+      CheckedSources++;
+      if (Sharded)
+        ShardResults.push_back(std::make_pair(I, std::move(Result)));
+
+      // a check can stop as soon as it has found enough files to fail,
+      // the workers finish what they have started and take nothing new.
+      // On the last source there is nothing left to skip, the run is
+      // complete and its headers are still checked
+      if (CheckLimit > 0 && UntidyFiles.size() >= CheckLimit &&
+          CheckedSources < Sources.size()) {
+        StopScheduling = true;
+        break;
+      }
+    }
+
+    for (auto &Thread : Threads)
+      Thread.join();
+
+    // a shard only has part of what its headers need, the merge
+    // of all shards writes them, and so does a check that stopped early
+    if (!Sharded && !StopScheduling)
+      finishHeaders(OS);
+
+    // shards sharing a cache directory would overwrite each other's index
+    if (Index && !Sharded && !Index->save())
+      errs() << "Couldn't save the include index.\n";
+
+    return ProcessingFailed ? 1 : 0;
+  }
+
+  void ImportRunner::runWorker(unsigned Worker) {
+    // each worker owns its matcher state, nothing is shared with
+    // other workers until the results are merged
+    MatchFinder Finder;
+    ImportMatcher Matcher;
+    Matcher.setOptions(Options);
+    auto Factory = Matcher.getActionFactory(Finder);
+    Matcher.setRecordDependencies(Cache != nullptr || CountIncludingUnits);
+    Matcher.setHeaderCache(&TidiedHeaders);
+
+    size_t Next;
+    while (!StopScheduling && (Next = NextSource++) < Sources.size()) {
+      auto I = Sources[Next];
+      auto File = getAbsolutePath(SourcePaths[I]);
+      auto Commands = Compilations.getCompileCommands(File);
+      std::string Key;
+      TUResult Result;
+
+      // unchanged translation units are replayed without running clang,
+      // unless they are parsed for the micro-benchmark
+      if (Cache && !Commands.empty() && !Options.MicroBenchIterations) {
+        Key = ResultCache::key(File, Commands, optionsKey());
+        if (Cache->lookup(Key, Result)) {
+          Result.Log = "Using cached result for " + File + "\n";
+          Result.Stats.Cached = true;
+          Result.Stats.Worker = Worker;
+          finishResult(I, std::move(Result));
+          continue;
+        }
+      }
+
+      bool Succeeded;
+      if (Options.VerifySkippedBodies) {
+        Succeeded = verifySkippedBodies(File, Commands, Matcher, *Factory, Result);
+      } else {
+        Succeeded = runTranslationUnit(File, Commands, *Factory);
+        Result = Matcher.takeResult();
+      }
+
+      if (!Succeeded) {
+        ProcessingFailed = true;
+      } else if (!Key.empty()) {
+        addPrefixDependencies(File, Commands, Result);
+        Cache->store(Key, Result);
+      }
+      if (Options.CollectStats) {
+        Result.Stats.Worker = Worker;
+        Result.Stats.PeakRSS = ImportStats::peakRSS();
+      }
+      finishResult(I, std::move(Result));
+    }
+  }
+
+  void ImportRunner::finishResult(size_t I, TUResult Result) {
+    std::lock_guard<std::mutex> Lock(ResultsMutex);
+    Results[I] = std::move(Result);
+    Finished[I] = true;
+    ResultReady.notify_all();
+  }
+
+  bool ImportRunner::runTranslationUnit(StringRef File,
+                                        ArrayRef<CompileCommand> Commands,
+                                        FrontendActionFactory &Factory) {
+    if (Commands.empty()) {
+      errs() << ("Skipping " + File + ". Compile command not found.\n").str();
+      return true;
+    }
+
+    bool Succeeded = true;
+    for (auto &Command : Commands) {
+      auto Sysroot = commandSysroot(Command);
+      if (!Sysroot.empty())
+        FileSystem->addStableDirectory(Sysroot);
+
+      auto Adjusted = Command;
+      Adjusted.CommandLine = getClangSyntaxOnlyAdjuster()(
+                               getClangStripOutputAdjuster()(Command.CommandLine));
+      auto CommandLine = invocationCommandLine(Adjusted);
+      if (!ModuleCachePath.empty() &&
+          std::find(CommandLine.begin(), CommandLine.end(), "-fmodules") !=
+            CommandLine.end()) {
+        CommandLine.push_back("-fmodules-cache-path=" + ModuleCachePath);
+        CommandLine.push_back("-fbuild-session-timestamp=" +
+                              std::to_string(BuildSession));
+        CommandLine.push_back("-fmodules-validate-once-per-build-session");
+      }
+      if (Prefixes) {
+        if (auto *Prefix = Prefixes->lookup(File, Command)) {
+          CommandLine.insert(CommandLine.begin() + 1, "-include-pch");
+          CommandLine.insert(CommandLine.begin() + 2, Prefix->PCHPath);
+        }
+      }
+
+      FileSystemOptions FileSystemOpts;
+      FileSystemOpts.WorkingDir = Command.Directory;
+      IntrusiveRefCntPtr<FileManager> Files(new FileManager(FileSystemOpts,
+                                                            FileSystem));
+      ToolInvocation Invocation(std::move(CommandLine), &Factory, Files.get());
+      if (!Invocation.run()) {
+        errs() << ("Error while processing " + File + ".\n").str();
+        Succeeded = false;
+      }
+    }
+    return Succeeded;
+  }
+
+  bool ImportRunner::verifySkippedBodies(StringRef File,
+                                         ArrayRef<CompileCommand> Commands,
+                                         ImportMatcher &Matcher,
+                                         FrontendActionFactory &Factory,
+                                         TUResult &Result) {
+    // parse with skipped bodies first, so the full parse is what the
+    // matcher is left with
+    auto Opts = Options;
+    Opts.SkipHeaderBodies = true;
+    Matcher.setOptions(Opts);
+    bool Succeeded = runTranslationUnit(File, Commands, Factory);
+    auto Skipped = Matcher.takeResult();
+
+    Opts.SkipHeaderBodies = false;
+    Matcher.setOptions(Opts);
+    Succeeded &= runTranslationUnit(File, Commands, Factory);
+    Result = Matcher.takeResult();
+    Matcher.setOptions(Options);
+
+    raw_string_ostream Log(Result.Log);
+    Log << "Skipping header bodies: parsed in "
+        << format("%.2f", Result.Stats.ParseTime) << " ms -> "
+        << format("%.2f", Skipped.Stats.ParseTime) << " ms\n";
+
+    std::map<std::string, std::string> SkippedBlocks;
+    for (auto &F : Skipped.Files)
+      SkippedBlocks[F.Path] = F.Block;
+    for (auto &F : Result.Files) {
+      auto Found = SkippedBlocks.find(F.Path);
+      if (Found == SkippedBlocks.end() || Found->second != F.Block)
+        Log << "warning: skipping header bodies changes the imports of "
+            << F.Path << "\n";
+      if (Found != SkippedBlocks.end())
+        SkippedBlocks.erase(Found);
+    }
+    for (auto &Pair : SkippedBlocks)
+      Log << "warning: skipping header bodies changes the imports of "
+          << Pair.first << "\n";
+
+    return Succeeded;
+  }
+
+  void ImportRunner::addPrefixDependencies(StringRef File,
+                                           ArrayRef<CompileCommand> Commands,
+                                           TUResult &Result) {
+    // headers in a precompiled prefix are never entered by the translation
+    // unit itself, but a change to any of them can still change its result
+    if (!Prefixes)
+      return;
+
+    std::set<std::string> Dependencies(Result.Dependencies.begin(),
+                                       Result.Dependencies.end());
+    for (auto &Command : Commands) {
+      if (auto *Prefix = Prefixes->built(File, Command))
+        Dependencies.insert(Prefix->Dependencies.begin(),
+                            Prefix->Dependencies.end());
+    }
+    Result.Dependencies.assign(Dependencies.begin(), Dependencies.end());
+  }
+
+  std::string ImportRunner::optionsKey() const {
+    // options that change the imports written for the same input
+    std::string Key;
+    if (Options.SkipHeaderBodies && !Options.VerifySkippedBodies)
+      Key += "skip-header-bodies;";
+    if (Options.ModuleImports)
+      Key += "module-imports;";
+    if (Options.IncludeGraph)
+      Key += "include-graph;";
+    if (Options.ImportEdges)
+      Key += "import-edges;";
+    if (Options.MainFilesOnly)
+      Key += "main-files-only;";
+    return Key;
+  }
+
+  void ImportRunner::mergeResult(StringRef File, TUResult &Result, raw_ostream &OS) {
+    OS << Result.Log;
+    if (Stats)
+      Stats->addResult(File, Result.Stats);
+
+    for (auto &Pair : Result.LibraryCounts)
+      LibraryCounts[Pair.first] += Pair.second;
+    for (auto &Pair : Result.FileCounts)
+      FileCounts[Pair.first] += Pair.second;
+    if (CountIncludingUnits) {
+      for (auto &Path : Result.Dependencies)
+        IncludingUnits[Path]++;
+    }
+    ImportMemo.Hits += Result.Stats.ImportMemo.Hits;
+    ImportMemo.Misses += Result.Stats.ImportMemo.Misses;
+    TypeMemo.Hits += Result.Stats.TypeMemo.Hits;
+    TypeMemo.Misses += Result.Stats.TypeMemo.Misses;
+    if (Graph)
+      Graph->addTranslationUnit(getAbsolutePath(File), Result.Includes);
+    // a result without its headers would make the index forget them
+    if (Index && !Options.MainFilesOnly)
+      Index->addResult(getAbsolutePath(File), Result, RunStarted);
+
+    std::vector<Replacement> Fixes;
+    for (auto &File : Result.Files) {
+      // headers get every import any translation unit needs, once all
+      // of them are merged
+      if (File.IsHeader) {
+        MergedHeaders.add(File);
+        continue;
+      }
+
+      // the first translation unit in source order to tidy a file wins
+      if (!TidiedFiles.insert(File.Path).second)
+        continue;
+
+      if (Edges)
+        Edges->addFile(File);
+      if (addReplacements(File) && !FixesDirectory.empty())
+        Fixes.insert(Fixes.end(), File.Replacements.begin(), File.Replacements.end());
+      if (!Quiet) {
+        OS << "File: " << File.Path << "\n";
+        OS << File.Block << "\n";
+      }
+    }
+    if (!Fixes.empty())
+      exportFixes(getAbsolutePath(File), std::move(Fixes));
+  }
+
+  bool ImportRunner::addReplacements(const FileImports &File, bool Write) {
+    if (Graph)
+      Graph->setTidiedImports(File.Path, File.ImportedFiles);
+
+    // a block that is already tidy is left alone, rewriting it would only
+    // touch the file and rebuild everything that includes it
+    std::string Content;
+    bool Changed;
+    if (!applyReplacements(File.Path, File.Replacements, Content, Changed)) {
+      errs() << "Skipped the replacements of " << File.Path << ".\n";
+      return false;
+    }
+    if (!Changed) {
+      UnchangedFiles++;
+      return false;
+    }
+    UntidyFiles.push_back(File.Path);
+
+    Replacements.insert(File.Replacements.begin(), File.Replacements.end());
+    if (!Writer || !SaveFiles)
+      return true;
+    if (Write)
+      Writer->write(File.Path, std::move(Content));
+    else
+      PendingFiles.push_back(std::make_pair(File.Path, std::move(Content)));
+    return true;
+  }
+
+  void ImportRunner::exportFixes(StringRef MainFile, std::vector<Replacement> Fixes,
+                                 bool Write) {
+    // the format clang-apply-replacements reads, one file per unit
+    TranslationUnitReplacements TUR;
+    TUR.MainSourceFile = MainFile;
+    TUR.Replacements = std::move(Fixes);
+    std::string Content;
+    raw_string_ostream OS(Content);
+    yaml::Output YAML(OS);
+    YAML << TUR;
+    OS.flush();
+
+    SmallString<256> Path(FixesDirectory);
+    sys::path::append(Path, sys::path::filename(MainFile) + "-" +
+                            Twine(ExportedFixes++) + ".yaml");
+    if (Write)
+      Writer->write(Path, std::move(Content));
+    else
+      PendingFiles.push_back(std::make_pair(Path.str(), std::move(Content)));
+  }
+
+  void ImportRunner::startWriter() {
+    bool Export = !FixesDirectory.empty();
+    Writer.reset(SaveFiles || Export ? new FileWriter() : nullptr);
+    if (Writer)
+      Writer->start();
+    if (Export && sys::fs::create_directories(FixesDirectory))
+      errs() << "Couldn't create " << FixesDirectory << ".\n";
+    PendingFiles.clear();
+    UnchangedFiles = 0;
+    ExportedFixes = 0;
+  }
+
+  void ImportRunner::finishHeaders(raw_ostream &OS) {
+    // headers are only written by saveReplacements, once every
+    // translation unit is known to have contributed
+    std::vector<FileImports> Files;
+    MergedHeaders.finish(Files);
+    std::vector<Replacement> Fixes;
+    for (auto &File : Files) {
+      if (Index)
+        Index->addHeaderBlock(File.Path, File.Block);
+      if (Edges)
+        Edges->addFile(File);
+      if (addReplacements(File, /*Write=*/false) && !FixesDirectory.empty())
+        Fixes.insert(Fixes.end(), File.Replacements.begin(), File.Replacements.end());
+      if (!Quiet) {
+        OS << "File: " << File.Path << "\n";
+        OS << File.Block << "\n";
+      }
+    }
+    if (!Fixes.empty())
+      exportFixes("headers", std::move(Fixes), /*Write=*/false);
+  }
+
+  void ImportRunner::skipTidySources(raw_ostream &OS) {
+    // a lexer pass over the files of each source is enough to tell it is
+    // still tidy, those sources are neither parsed nor replayed
+    std::vector<std::string> Paths;
+    for (auto I : Sources)
+      Paths.push_back(getAbsolutePath(SourcePaths[I]));
+    auto Tidy = Index->tidySources(Paths, *FileSystem);
+
+    std::vector<size_t> Remaining;
+    for (size_t J = 0; J < Sources.size(); J++) {
+      if (!Tidy[J])
+        Remaining.push_back(Sources[J]);
+    }
+    if (Remaining.size() < Sources.size())
+      OS << "Skipping " << (Sources.size() - Remaining.size())
+         << " sources that are still tidy\n";
+    Sources = std::move(Remaining);
+  }
+
+  bool ImportRunner::writeShard(StringRef Path) {
+    int FD;
+    SmallString<256> TempPath;
+    if (sys::fs::createUniqueFile(Path + "-%%%%%%.tmp", FD, TempPath))
+      return false;
+
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      writeString(OS, kShardMagic);
+      writeNumber(OS, kShardVersion);
+      // every shard has the whole list, so the merge can tell shards of
+      // different runs apart
+      writeNumber(OS, SourcePaths.size());
+      for (auto &Source : SourcePaths)
+        writeString(OS, Source);
+      writeNumber(OS, ProcessingFailed ? 1 : 0);
+      writeNumber(OS, ShardResults.size());
+      for (auto &Pair : ShardResults) {
+        writeNumber(OS, Pair.first);
+        writeString(OS, SourcePaths[Pair.first]);
+        writeResult(OS, Pair.second);
+      }
+      OS.close();
+      if (OS.has_error()) {
+        OS.clear_error();
+        sys::fs::remove(TempPath.str());
+        return false;
+      }
+    }
+
+    if (sys::fs::rename(TempPath.str(), Path)) {
+      sys::fs::remove(TempPath.str());
+      return false;
+    }
+    return true;
+  }
+
+  int ImportRunner::mergeShards(ArrayRef<std::string> Paths, raw_ostream &OS) {
+    struct ShardResult {
+      uint64_t Index;
+      std::string Source;
+      TUResult Result;
+    };
+    std::vector<ShardResult> All;
+    std::vector<std::string> SourceList;
+    bool Failed = false;
+    Graph.reset(Options.IncludeGraph ? new ImportGraph() : nullptr);
+
+    for (auto &Path : Paths) {
+      auto Buffer = MemoryBuffer::getFile(Path);
+      if (!Buffer) {
+        errs() << "Couldn't read shard " << Path << ".\n";
+        return 1;
+      }
+
+      StringRef Data = (*Buffer)->getBuffer();
+      std::string Magic;
+      uint64_t Version, Sources, ShardFailed, Count;
+      std::vector<std::string> Paths;
+      bool Valid = readString(Data, Magic) && Magic == kShardMagic &&
+                   readNumber(Data, Version) && Version == kShardVersion &&
+                   readNumber(Data, Sources);
+      for (uint64_t I = 0; Valid && I < Sources; I++) {
+        Paths.emplace_back();
+        Valid = readString(Data, Paths.back());
+      }
+      Valid = Valid && readNumber(Data, ShardFailed) && readNumber(Data, Count);
+
+      // every shard has to have run the same sources in the same order
+      if (!Valid || (!SourceList.empty() && Paths != SourceList)) {
+        errs() << "Shard " << Path << " is invalid or from a different run.\n";
+        return 1;
+      }
+      SourceList = std::move(Paths);
+      Failed |= ShardFailed != 0;
+
+      for (uint64_t I = 0; I < Count; I++) {
+        ShardResult Entry;
+        if (!readNumber(Data, Entry.Index) || !readString(Data, Entry.Source) ||
+            !readResult(Data, Entry.Result)) {
+          errs() << "Shard " << Path << " is truncated.\n";
+          return 1;
+        }
+        if (Entry.Index >= SourceList.size() ||
+            Entry.Source != SourceList[Entry.Index]) {
+          errs() << "Shard " << Path << " has results for " << Entry.Source
+                 << " that don't match its sources.\n";
+          return 1;
+        }
+        All.push_back(std::move(Entry));
+      }
+    }
+
+    // merging in source order makes the output independent of how the
+    // sources were split, as if a single process had run them all
+    std::sort(All.begin(), All.end(), [](const ShardResult &L, const ShardResult &R) {
+      return L.Index < R.Index;
+    });
+    for (size_t I = 1; I < All.size(); I++) {
+      if (All[I].Index == All[I - 1].Index) {
+        errs() << All[I].Source << " is in more than one shard.\n";
+        return 1;
+      }
+    }
+    if (All.size() != SourceList.size())
+      errs() << "Missing the results of " << (SourceList.size() - All.size())
+             << " sources, not every shard was merged.\n";
+
+    startWriter();
+    for (auto &Entry : All)
+      mergeResult(Entry.Source, Entry.Result, OS);
+    finishHeaders(OS);
+
+    return Failed || All.size() != SourceList.size() ? 1 : 0;
+  }
+
+  bool ImportRunner::saveReplacements() {
+    if (!Writer)
+      return true;
+
+    // main files were written to temporary files as they were merged,
+    // the headers are added and then all of them are renamed into place
+    auto Start = std::chrono::steady_clock::now();
+    for (auto &File : PendingFiles)
+      Writer->write(File.first, std::move(File.second));
+    PendingFiles.clear();
+    bool Saved = Writer->finish();
+    if (Stats)
+      Stats->addEvent("save", Start, std::chrono::steady_clock::now());
+    return Saved;
+  }
+
+  void ImportRunner::printCheckSummary(raw_ostream &OS) {
+    for (auto &File : UntidyFiles)
+      OS << "Needs tidying: " << File << "\n";
+
+    if (UntidyFiles.empty())
+      OS << "All " << CheckedSources << " sources are tidy";
+    else
+      OS << UntidyFiles.size() << " files need their imports tidied";
+    if (StopScheduling)
+      OS << ", stopped after " << CheckedSources << " of " << Sources.size()
+         << " sources";
+    OS << "\n";
+  }
+
+  void ImportRunner::printLibraryCounts(raw_ostream &OS) {
+    if (LibraryCounts.size() == 0)
+      return;
+
+    using ImpPair = std::pair<StringRef, unsigned>;
+    std::vector<ImpPair> counts(LibraryCounts.begin(), LibraryCounts.end());
+    std::sort(counts.begin(), counts.end(), [](const ImpPair &L, const ImpPair &R) {
+      return L.second < R.second;
+    });
+
+    OS << "\n\n";
+    OS << "--------------------------------" << "\n";
+    OS << "Libraries sorted by import count" << "\n";
+    OS << "--------------------------------" << "\n";
+    const unsigned kThreshold = 5;
+    for (auto I = counts.rbegin(); I != counts.rend() && I->second >= kThreshold; I++) {
+      OS << I->first << " : " << I->second << " times\n";
+    }
+  }
+
+  void ImportRunner::printCacheStats(raw_ostream &OS) {
+    printMemoStats(OS, "Decl imports", ImportMemo);
+    printMemoStats(OS, "Type imports", TypeMemo);
+    TidiedHeaders.printStats(OS);
+    if (Cache)
+      Cache->printStats(OS);
+    if (Prefixes)
+      Prefixes->printStats(OS);
+    if (FileSystem)
+      FileSystem->printStats(OS);
+    if (Writer) {
+      OS << "Files: " << Writer->getWritten() << " written, "
+         << UnchangedFiles << " already tidy\n";
+    }
+  }
+
+  void ImportRunner::printImportGraph(raw_ostream &OS) {
+    if (Graph)
+      Graph->print(OS);
+  }
+
+#pragma mark - Helpers
+
+  std::vector<std::string> invocationCommandLine(const CompileCommand &Command) {
+    // ClangTool would chdir into the compile directory, which is not
+    // safe with several workers, so resolve paths against it instead
+    auto CommandLine = Command.CommandLine;
+    CommandLine[0] = mainExecutable();
+    CommandLine.insert(CommandLine.begin() + 1, "-working-directory");
+    CommandLine.insert(CommandLine.begin() + 2, Command.Directory);
+    return CommandLine;
+  }
+
+} // end namespace import_tidy
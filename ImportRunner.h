@@ -0,0 +1,186 @@
+#ifndef __LLVM__ImportRunner__
+#define __LLVM__ImportRunner__
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Refactoring.h"
+#include "llvm/ADT/StringSet.h"
+#include "ImportCache.h"
+#include "ImportFileSystem.h"
+#include "ImportGraph.h"
+#include "ImportIndex.h"
+#include "ImportMatcher.h"
+#include "ImportPrefix.h"
+#include "ImportResult.h"
+#include "ImportStats.h"
+#include "ImportWriter.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace import_tidy {
+
+  class ImportRunner {
+  public:
+    ImportRunner(const clang::tooling::CompilationDatabase &Compilations,
+                 llvm::ArrayRef<std::string> SourcePaths) :
+      Compilations(Compilations), SourcePaths(SourcePaths), Jobs(1),
+      ShardIndex(0), ShardCount(1), Sharded(false), Prepared(false),
+      BuildSession(0), Edges(nullptr), SaveFiles(false), UnchangedFiles(0),
+      Prefilter(false), RunStarted(0), Quiet(false), ExportedFixes(0),
+      CheckLimit(0), CheckedSources(0), CountIncludingUnits(false) {};
+
+    void setJobs(unsigned J) { Jobs = J; }
+    void setSourcePaths(llvm::ArrayRef<std::string> Paths) {
+      SourcePaths = Paths;
+    }
+    void setShard(unsigned Index, unsigned Count) {
+      ShardIndex = Index;
+      ShardCount = Count;
+      Sharded = true;
+    }
+    void setMatchOptions(const MatchOptions &O) { Options = O; }
+    void setCacheDirectory(llvm::StringRef Directory);
+    void setModuleCachePath(llvm::StringRef Path) { ModuleCachePath = Path; }
+    void setGraphWriter(GraphWriter *Writer) { Edges = Writer; }
+
+    // write tidied main files to temporary files while the run goes on,
+    // saveReplacements adds the headers and renames them all into place
+    void setSaveFiles(bool Save) { SaveFiles = Save; }
+
+    // skip the sources the include index shows are still tidy
+    void setPrefilter(bool P) { Prefilter = P; }
+
+    // write the replacements of each translation unit to a YAML file in
+    // Directory instead of the tidied files, and leave out the import
+    // blocks of the log
+    void setExportFixes(llvm::StringRef Directory) { FixesDirectory = Directory; }
+    void setQuiet(bool Q) { Quiet = Q; }
+
+    // stop taking new sources once Limit files are known to need
+    // tidying, 0 checks every source
+    void setCheckLimit(unsigned Limit) { CheckLimit = Limit; }
+    // count the translation units that include each file, for
+    // -prefix-report
+    void setCountIncludingUnits(bool Count) { CountIncludingUnits = Count; }
+    void setPrecompileImports(bool Precompile) {
+      Prefixes.reset(Precompile ? new PrefixHeaders() : nullptr);
+    }
+    void prepare();
+    bool hasIncludeIndex() const { return Index != nullptr; }
+    std::vector<std::string>
+      affectedSources(llvm::ArrayRef<std::string> ChangedFiles) const;
+    int run(llvm::raw_ostream&);
+    bool writeShard(llvm::StringRef Path);
+    int mergeShards(llvm::ArrayRef<std::string> Paths, llvm::raw_ostream&);
+    bool saveReplacements();
+    clang::tooling::Replacements &getReplacements() { return Replacements; }
+    void printLibraryCounts(llvm::raw_ostream&);
+    const std::map<std::string, unsigned> &getLibraryCounts() const {
+      return LibraryCounts;
+    }
+    const std::map<std::string, unsigned> &getFileCounts() const {
+      return FileCounts;
+    }
+    const std::map<std::string, unsigned> &getIncludingUnits() const {
+      return IncludingUnits;
+    }
+    void printCacheStats(llvm::raw_ostream&);
+    void printImportGraph(llvm::raw_ostream&);
+    void printCheckSummary(llvm::raw_ostream&);
+
+    // the files whose import blocks the last run would change
+    const std::vector<std::string> &getUntidyFiles() const { return UntidyFiles; }
+    ImportStats *getStats() { return Stats.get(); }
+  private:
+    void runWorker(unsigned Worker);
+    void finishResult(size_t Index, TUResult);
+    bool runTranslationUnit(llvm::StringRef File,
+                            llvm::ArrayRef<clang::tooling::CompileCommand>,
+                            clang::tooling::FrontendActionFactory&);
+    bool verifySkippedBodies(llvm::StringRef File,
+                             llvm::ArrayRef<clang::tooling::CompileCommand>,
+                             ImportMatcher&,
+                             clang::tooling::FrontendActionFactory&,
+                             TUResult&);
+    void addPrefixDependencies(llvm::StringRef File,
+                               llvm::ArrayRef<clang::tooling::CompileCommand>,
+                               TUResult&);
+    std::string optionsKey() const;
+    void mergeResult(llvm::StringRef File, TUResult&, llvm::raw_ostream&);
+    bool addReplacements(const FileImports&, bool Write = true);
+    void exportFixes(llvm::StringRef MainFile,
+                     std::vector<clang::tooling::Replacement> Fixes,
+                     bool Write = true);
+    void startWriter();
+    void finishHeaders(llvm::raw_ostream&);
+    void skipTidySources(llvm::raw_ostream&);
+    const clang::tooling::CompilationDatabase &Compilations;
+    std::vector<std::string> SourcePaths;
+    unsigned Jobs;
+    MatchOptions Options;
+
+    // a shard processes every ShardCount-th source starting at ShardIndex
+    // and keeps its results for the merge
+    unsigned ShardIndex;
+    unsigned ShardCount;
+    bool Sharded;
+    std::vector<size_t> Sources;
+    std::vector<std::pair<size_t, TUResult>> ShardResults;
+
+    // work shared between the workers and the merging thread
+    std::mutex ResultsMutex;
+    std::condition_variable ResultReady;
+    std::atomic<size_t> NextSource;
+    std::atomic<bool> ProcessingFailed;
+    std::atomic<bool> StopScheduling;
+    std::vector<TUResult> Results;
+    std::vector<bool> Finished;
+    std::unique_ptr<ResultCache> Cache;
+    std::unique_ptr<IncludeIndex> Index;
+    bool Prefilter;
+    uint64_t RunStarted;
+    std::unique_ptr<PrefixHeaders> Prefixes;
+    bool Prepared;
+    llvm::IntrusiveRefCntPtr<CachingFileSystem> FileSystem;
+
+    // modules of every translation unit are built into one cache and
+    // validated once per run
+    std::string ModuleCachePath;
+    uint64_t BuildSession;
+
+    // merged output of the whole run
+    clang::tooling::Replacements Replacements;
+    llvm::StringSet<> TidiedFiles;
+    HeaderImports MergedHeaders;
+    HeaderCache TidiedHeaders;
+    std::map<std::string, unsigned> LibraryCounts;
+    std::map<std::string, unsigned> FileCounts;
+    bool CountIncludingUnits;
+    std::map<std::string, unsigned> IncludingUnits;
+    std::unique_ptr<ImportGraph> Graph;
+    GraphWriter *Edges;
+    bool SaveFiles;
+    std::unique_ptr<FileWriter> Writer;
+    std::vector<std::pair<std::string, std::string>> PendingFiles;
+    unsigned UnchangedFiles;
+    std::string FixesDirectory;
+    bool Quiet;
+    unsigned ExportedFixes;
+    unsigned CheckLimit;
+    size_t CheckedSources;
+    std::vector<std::string> UntidyFiles;
+    MemoStats ImportMemo;
+    MemoStats TypeMemo;
+    std::unique_ptr<ImportStats> Stats;
+  };
+
+  // the arguments to run a compile command with a ToolInvocation from
+  // its own directory, without changing the working directory of the tool
+  std::vector<std::string>
+  invocationCommandLine(const clang::tooling::CompileCommand&);
+}
+
+#endif /* defined(__LLVM__ImportRunner__) */
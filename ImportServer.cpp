@@ -0,0 +1,172 @@
+#include "ImportServer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace {
+
+  static bool writeAll(int FD, StringRef Data) {
+    while (!Data.empty()) {
+      auto Written = ::write(FD, Data.data(), Data.size());
+      if (Written < 0 && errno == EINTR)
+        continue;
+      if (Written <= 0)
+        return false;
+      Data = Data.drop_front(Written);
+    }
+    return true;
+  }
+
+  // a socket left behind by a server that didn't exit cleanly is removed,
+  // anything else at Path, or a socket a server still accepts on, is kept
+  static bool removeStaleSocket(StringRef Path, const struct sockaddr_un &Address) {
+    struct stat Status;
+    if (::lstat(Address.sun_path, &Status) != 0)
+      return errno == ENOENT;
+
+    if (!S_ISSOCK(Status.st_mode)) {
+      errs() << Path << " exists and is not a socket.\n";
+      return false;
+    }
+
+    int Probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Probe < 0)
+      return false;
+    bool Live = ::connect(Probe, reinterpret_cast<const struct sockaddr *>(&Address),
+                          sizeof(Address)) == 0;
+    ::close(Probe);
+    if (Live) {
+      errs() << "Another server is already listening on " << Path << ".\n";
+      return false;
+    }
+    return ::unlink(Address.sun_path) == 0 || errno == ENOENT;
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - ImportServer
+
+  ImportServer::~ImportServer() {
+    if (Socket < 0)
+      return;
+    ::close(Socket);
+    sys::fs::remove(SocketPath);
+  }
+
+  bool ImportServer::listen(StringRef Path) {
+    struct sockaddr_un Address;
+    if (Path.size() >= sizeof(Address.sun_path)) {
+      errs() << "The socket path " << Path << " is too long.\n";
+      return false;
+    }
+
+    std::memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_UNIX;
+    std::memcpy(Address.sun_path, Path.data(), Path.size());
+    if (!removeStaleSocket(Path, Address))
+      return false;
+
+    Socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Socket < 0 ||
+        ::bind(Socket, reinterpret_cast<struct sockaddr *>(&Address),
+               sizeof(Address)) != 0 ||
+        ::listen(Socket, 8) != 0) {
+      errs() << "Couldn't listen on " << Path << ": "
+             << std::strerror(errno) << ".\n";
+      if (Socket >= 0)
+        ::close(Socket);
+      Socket = -1;
+      return false;
+    }
+
+    SocketPath = Path;
+    return true;
+  }
+
+  int ImportServer::serve() {
+    // a client going away mid response must not end the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // build what can be kept warm before the first request arrives
+    Runner.prepare();
+    errs() << "Listening on " << SocketPath << "\n";
+
+    while (true) {
+      int FD = ::accept(Socket, nullptr, nullptr);
+      if (FD < 0) {
+        if (errno == EINTR || errno == ECONNABORTED)
+          continue;
+        errs() << "Couldn't accept a connection: " << std::strerror(errno) << ".\n";
+        return 1;
+      }
+      handleConnection(FD);
+      ::close(FD);
+    }
+  }
+
+  void ImportServer::handleConnection(int FD) {
+    std::string Buffer;
+    char Chunk[4096];
+    while (true) {
+      auto Read = ::read(FD, Chunk, sizeof(Chunk));
+      if (Read < 0 && errno == EINTR)
+        continue;
+      if (Read <= 0)
+        return;
+      Buffer.append(Chunk, Read);
+
+      // answer every complete line, the rest waits for more data
+      size_t End;
+      while ((End = Buffer.find('\n')) != std::string::npos) {
+        auto File = StringRef(Buffer).substr(0, End).trim().str();
+        Buffer.erase(0, End + 1);
+        if (File.empty())
+          continue;
+        if (!writeAll(FD, handleRequest(File)))
+          return;
+      }
+    }
+  }
+
+  std::string ImportServer::handleRequest(StringRef File) {
+    auto Start = std::chrono::steady_clock::now();
+    std::string Output;
+    raw_string_ostream OS(Output);
+    Runner.setSourcePaths(File.str());
+    int Status = Runner.run(OS);
+    OS.flush();
+
+    std::string Response;
+    raw_string_ostream RS(Response);
+    writeNumber(RS, Status);
+    writeString(RS, Output);
+    auto &Replaces = Runner.getReplacements();
+    writeNumber(RS, Replaces.size());
+    for (auto &R : Replaces) {
+      writeString(RS, R.getFilePath());
+      writeNumber(RS, R.getOffset());
+      writeNumber(RS, R.getLength());
+      writeString(RS, R.getReplacementText());
+    }
+    RS.flush();
+
+    std::chrono::duration<double, std::milli> Time =
+      std::chrono::steady_clock::now() - Start;
+    errs() << "Tidied " << File << " in " << format("%.2f", Time.count()) << " ms\n";
+    return Response;
+  }
+
+} // end namespace import_tidy
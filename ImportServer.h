@@ -0,0 +1,36 @@
+#ifndef __LLVM__ImportServer__
+#define __LLVM__ImportServer__
+
+#include "llvm/ADT/StringRef.h"
+#include "ImportRunner.h"
+#include <string>
+
+namespace import_tidy {
+
+  // Tidies single files on request over a Unix domain socket, so an editor
+  // doesn't pay for process startup and loading the compilation database on
+  // every save. The runner, and with it the precompiled imports and the
+  // result cache, lives as long as the server.
+  //
+  // A request is the path of a file on a line of its own. The response is
+  // the exit status, the output a run would print and the replacements for
+  // the file and its headers, in the length prefixed format of writeString
+  // and writeNumber. Nothing is written to disk, the client applies the
+  // replacements. A connection takes any number of requests.
+  class ImportServer {
+  public:
+    ImportServer(ImportRunner &Runner) : Runner(Runner), Socket(-1) {};
+    ~ImportServer();
+
+    bool listen(llvm::StringRef Path);
+    int serve();
+  private:
+    void handleConnection(int FD);
+    std::string handleRequest(llvm::StringRef File);
+    ImportRunner &Runner;
+    std::string SocketPath;
+    int Socket;
+  };
+}
+
+#endif /* defined(__LLVM__ImportServer__) */
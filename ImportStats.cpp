@@ -0,0 +1,195 @@
+#include "ImportStats.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include <algorithm>
+#include <map>
+#include <sys/resource.h>
+
+using namespace llvm;
+
+namespace {
+
+  static double totalTime(const std::vector<import_tidy::TraceEvent> &Events,
+                          StringRef Name) {
+    double Total = 0;
+    for (auto &Event : Events) {
+      if (Event.Name == Name)
+        Total += Event.Duration;
+    }
+    return Total;
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - ImportStats
+
+  void ImportStats::addResult(StringRef File, const TUStats &Stats) {
+    FileStats Entry = { File.str(), Stats };
+    Files.push_back(std::move(Entry));
+  }
+
+  void ImportStats::addEvent(StringRef Name,
+                             std::chrono::steady_clock::time_point Begin,
+                             std::chrono::steady_clock::time_point End) {
+    std::chrono::duration<double, std::micro> Time = Begin.time_since_epoch();
+    std::chrono::duration<double, std::micro> Duration = End - Begin;
+    TraceEvent Event = { Name.str(), Time.count(), Duration.count() };
+    Events.push_back(std::move(Event));
+  }
+
+  double ImportStats::relativeTime(double Time) const {
+    std::chrono::duration<double, std::micro> RunStart = Start.time_since_epoch();
+    return Time - RunStart.count();
+  }
+
+  uint64_t ImportStats::peakRSS() {
+    struct rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) != 0)
+      return 0;
+#if defined(__APPLE__)
+    // bytes on darwin, kilobytes everywhere else
+    return Usage.ru_maxrss / 1024;
+#else
+    return Usage.ru_maxrss;
+#endif
+  }
+
+  bool ImportStats::writeJSON(StringRef Path) const {
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::F_Text);
+    if (EC)
+      return false;
+
+    // phase times in milliseconds, summed over each translation unit
+    OS << "{\n  \"files\": [";
+    for (size_t I = 0; I < Files.size(); I++) {
+      auto &Stats = Files[I].Stats;
+      OS << (I ? ",\n" : "\n") << "    {\"file\": ";
+      writeJSONString(OS, Files[I].File);
+      OS << ", \"cached\": " << (Stats.Cached ? "true" : "false")
+         << ", \"worker\": " << Stats.Worker
+         << ", \"peak_rss_kb\": " << Stats.PeakRSS
+         << ",\n     \"phases\": {";
+
+      const char *Phases[] = {
+        "parse", "match", "sortedUniqueImports", "collapsedRanges", "flush"
+      };
+      for (auto *Phase : Phases) {
+        OS << '"' << Phase << "\": "
+           << format("%.3f", totalTime(Stats.Events, Phase) / 1000) << ", ";
+      }
+      OS << "\"resolveImport\": " << format("%.3f", Stats.ResolveTime / 1000);
+
+      OS << "},\n     \"callbacks\": {";
+      bool First = true;
+      for (auto &Pair : Stats.Callbacks) {
+        OS << (First ? "" : ", ") << '"' << Pair.first << "\": {\"matches\": "
+           << Pair.second.Matches << ", \"ms\": "
+           << format("%.3f", Pair.second.Time / 1000) << "}";
+        First = false;
+      }
+      OS << "}}";
+    }
+
+    OS << "\n  ],\n  \"phases\": {";
+    for (size_t I = 0; I < Events.size(); I++) {
+      OS << (I ? ", " : "") << '"' << Events[I].Name << "\": "
+         << format("%.3f", Events[I].Duration / 1000);
+    }
+    // -micro-bench-iterations, summed over every translation unit
+    std::map<std::string, MicroStats> Micro;
+    for (auto &Entry : Files) {
+      for (auto &Pair : Entry.Stats.Micro) {
+        Micro[Pair.first].Calls += Pair.second.Calls;
+        Micro[Pair.first].Time += Pair.second.Time;
+      }
+    }
+    OS << "},\n  \"micro\": {";
+    bool First = true;
+    for (auto &Pair : Micro) {
+      auto PerCall = Pair.second.Calls ? Pair.second.Time / Pair.second.Calls : 0;
+      OS << (First ? "" : ", ") << '"' << Pair.first << "\": {\"calls\": "
+         << Pair.second.Calls << ", \"total_us\": "
+         << format("%.3f", Pair.second.Time) << ", \"per_call_us\": "
+         << format("%.3f", PerCall) << "}";
+      First = false;
+    }
+    OS << "},\n  \"peak_rss_kb\": " << peakRSS() << "\n}\n";
+
+    OS.close();
+    return !OS.has_error();
+  }
+
+  bool ImportStats::writeTrace(StringRef Path) const {
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::F_Text);
+    if (EC)
+      return false;
+
+    // complete events, one row per worker and the main thread after them
+    bool First = true;
+    auto writeEvent = [&](const TraceEvent &Event, unsigned Thread,
+                          StringRef File, const TUStats *Stats) {
+      OS << (First ? "\n" : ",\n") << "  {\"name\": ";
+      writeJSONString(OS, Event.Name);
+      OS << ", \"cat\": \"import-tidy\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+         << Thread << ", \"ts\": " << format("%.3f", relativeTime(Event.Start))
+         << ", \"dur\": " << format("%.3f", Event.Duration) << ", \"args\": {";
+      if (!File.empty()) {
+        OS << "\"file\": ";
+        writeJSONString(OS, File);
+      }
+      if (Stats && Event.Name == "match") {
+        for (auto &Pair : Stats->Callbacks)
+          OS << ", \"" << Pair.first << "\": " << Pair.second.Matches;
+      }
+      OS << "}}";
+      First = false;
+    };
+
+    unsigned MainThread = 0;
+    OS << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (auto &Entry : Files) {
+      MainThread = std::max(MainThread, Entry.Stats.Worker + 1);
+      for (auto &Event : Entry.Stats.Events)
+        writeEvent(Event, Entry.Stats.Worker, Entry.File, &Entry.Stats);
+
+      // memory as a counter track, sampled after each translation unit
+      if (!Entry.Stats.Events.empty()) {
+        auto &Last = Entry.Stats.Events.back();
+        OS << ",\n  {\"name\": \"peak_rss_kb\", \"ph\": \"C\", \"pid\": 1, \"ts\": "
+           << format("%.3f", relativeTime(Last.Start + Last.Duration))
+           << ", \"args\": {\"kb\": " << Entry.Stats.PeakRSS << "}}";
+      }
+    }
+    for (auto &Event : Events)
+      writeEvent(Event, MainThread, StringRef(), nullptr);
+    OS << "\n]}\n";
+
+    OS.close();
+    return !OS.has_error();
+  }
+
+#pragma mark - Helpers
+
+  void writeJSONString(raw_ostream &OS, StringRef S) {
+    OS << '"';
+    for (auto C : S) {
+      switch (C) {
+        case '"': OS << "\\\""; break;
+        case '\\': OS << "\\\\"; break;
+        case '\n': OS << "\\n"; break;
+        case '\t': OS << "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(C) < 0x20)
+            OS << format("\\u%04x", C);
+          else
+            OS << C;
+      }
+    }
+    OS << '"';
+  }
+
+} // end namespace import_tidy
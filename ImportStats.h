@@ -0,0 +1,43 @@
+#ifndef __LLVM__ImportStats__
+#define __LLVM__ImportStats__
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include "ImportResult.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace import_tidy {
+
+  // Collects the measurements of every translation unit in a run, in source
+  // order, and writes them either as a JSON summary or as a trace that
+  // chrome://tracing can load, with one row per worker.
+  class ImportStats {
+  public:
+    ImportStats() : Start(std::chrono::steady_clock::now()) {};
+
+    void addResult(llvm::StringRef File, const TUStats&);
+    void addEvent(llvm::StringRef Name, std::chrono::steady_clock::time_point Start,
+                  std::chrono::steady_clock::time_point End);
+    bool writeJSON(llvm::StringRef Path) const;
+    bool writeTrace(llvm::StringRef Path) const;
+
+    // kilobytes, the high water mark of the whole process
+    static uint64_t peakRSS();
+  private:
+    struct FileStats {
+      std::string File;
+      TUStats Stats;
+    };
+    double relativeTime(double Time) const;
+    std::chrono::steady_clock::time_point Start;
+    std::vector<FileStats> Files;
+    std::vector<TraceEvent> Events;
+  };
+
+  // S quoted and escaped as a JSON string
+  void writeJSONString(llvm::raw_ostream&, llvm::StringRef S);
+}
+
+#endif /* defined(__LLVM__ImportStats__) */
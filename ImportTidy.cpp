@@ -39,10 +39,12 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Signals.h"
-#include "ImportMatcher.h"
+#include "ImportReport.h"
+#include "ImportRunner.h"
+#include "ImportServer.h"
+#include <thread>
 
 using namespace clang;
-using namespace clang::ast_matchers;
 using namespace clang::tooling;
 using namespace llvm;
 using namespace import_tidy;
@@ -50,16 +52,310 @@ using namespace import_tidy;
 // Set up the command line options
 static cl::extrahelp CommonHelp(CommonOptionsParser::HelpMessage);
 static cl::OptionCategory ImportTidyCategory("import-tidy options");
+static cl::opt<unsigned> Jobs("j",
+  cl::desc("Number of translation units to process concurrently, "
+           "0 uses every core"),
+  cl::init(1), cl::cat(ImportTidyCategory));
+static cl::opt<bool> UseMatchers("use-matchers",
+  cl::desc("Find imports with the AST matchers instead of the single pass "
+           "visitor, to compare the two"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<bool> MatchTime("match-time",
+  cl::desc("Print how long parsing and matching took for each translation unit"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<bool> SkipHeaderBodies("skip-header-bodies",
+  cl::desc("Don't parse function bodies outside the main file"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<bool> VerifySkippedBodies("verify-skipped-bodies",
+  cl::desc("Parse each translation unit with and without header bodies, "
+           "report the parse time of both and any imports that differ"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<bool> PrecompileImports("precompile-imports",
+  cl::desc("Precompile the SDK imports that files with the same flags "
+           "start with once, instead of parsing them for every file"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<std::string> ModuleCachePath("module-cache-path",
+  cl::desc("Build the modules of every translation unit compiled with "
+           "-fmodules into this directory, validated once per run"),
+  cl::value_desc("directory"), cl::cat(ImportTidyCategory));
+static cl::opt<bool> ModuleImports("module-imports",
+  cl::desc("Write @import X; instead of #import <X/X.h> for frameworks "
+           "with a module map"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<std::string> CacheDir("cache-dir",
+  cl::desc("Directory to keep results in between runs, translation units "
+           "whose sources and flags are unchanged are not parsed again"),
+  cl::value_desc("directory"), cl::cat(ImportTidyCategory));
+static cl::opt<std::string> ChangedSince("changed-since",
+  cl::desc("Only process the sources that include a file changed since this "
+           "git revision, and those that tidy the same headers, using the "
+           "index kept in -cache-dir"),
+  cl::value_desc("rev"), cl::cat(ImportTidyCategory));
+static cl::opt<bool> Prefilter("prefilter",
+  cl::desc("Lex the import blocks of each source and the headers it tidies "
+           "and skip it if they are what the last run left and nothing it "
+           "includes changed since, needs -cache-dir"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<bool> CacheStats("cache-stats",
+  cl::desc("Print cache hit and miss counts after the run"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<std::string> Shard("shard",
+  cl::desc("Only process every n-th source starting at the i-th, every shard "
+           "must be given the same sources in the same order"),
+  cl::value_desc("i/n"), cl::cat(ImportTidyCategory));
+static cl::opt<std::string> ShardOutput("shard-output",
+  cl::desc("Write the results of a shard to this file instead of rewriting "
+           "any files"),
+  cl::value_desc("file"), cl::cat(ImportTidyCategory));
+static cl::list<std::string> Merge("merge",
+  cl::desc("Merge the results of shards and rewrite the files, no sources "
+           "or compilation database are needed"),
+  cl::value_desc("shard files"), cl::CommaSeparated, cl::cat(ImportTidyCategory));
+static cl::opt<bool> ReportPrefix("prefix-report",
+  cl::desc("Measure the cost of the most imported headers and rank them as "
+           "candidates for a prefix header"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<std::string> ReportPrefixHeader("prefix-report-header",
+  cl::desc("Write a prefix header of the best candidates of -prefix-report"),
+  cl::value_desc("file"), cl::cat(ImportTidyCategory));
+static cl::opt<bool> IncludeGraph("include-graph",
+  cl::desc("Compare the bytes each translation unit includes and how many "
+           "translation units each project header rebuilds, before and "
+           "after tidying"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<std::string> EmitGraph("emit-graph",
+  cl::desc("Write every import edge of the tidied files with the decls that "
+           "caused it, as json or dot"),
+  cl::value_desc("format"), cl::cat(ImportTidyCategory));
+static cl::opt<std::string> GraphOutput("graph-output",
+  cl::desc("File to write the -emit-graph edges to, import-graph.json or "
+           "import-graph.dot by default"),
+  cl::value_desc("file"), cl::cat(ImportTidyCategory));
+static cl::opt<std::string> Serve("serve",
+  cl::desc("Keep running and tidy single files requested over this Unix "
+           "socket, the given sources are used to find shared imports"),
+  cl::value_desc("socket"), cl::cat(ImportTidyCategory));
+static cl::opt<std::string> ExportFixes("export-fixes",
+  cl::desc("Write the replacements of each translation unit as YAML for "
+           "clang-apply-replacements into this directory, instead of "
+           "rewriting any files"),
+  cl::value_desc("directory"), cl::cat(ImportTidyCategory));
+static cl::opt<bool> Quiet("quiet",
+  cl::desc("Don't print the import block of every tidied file"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<bool> Check("check",
+  cl::desc("Only report the files whose imports need tidying, without "
+           "writing anything, and exit with 1 if there are any"),
+  cl::cat(ImportTidyCategory));
+static cl::opt<unsigned> CheckLimit("check-limit",
+  cl::desc("Stop a -check once this many files need tidying, 0 checks "
+           "every source"),
+  cl::init(0), cl::cat(ImportTidyCategory));
+static cl::opt<std::string> StatsJSON("stats-json",
+  cl::desc("Write the time of each phase, the matches of each callback and "
+           "the peak memory of every translation unit as JSON"),
+  cl::value_desc("file"), cl::cat(ImportTidyCategory));
+static cl::opt<std::string> Trace("trace",
+  cl::desc("Write the phases of every translation unit as a trace for "
+           "chrome://tracing"),
+  cl::value_desc("file"), cl::cat(ImportTidyCategory));
+
+static cl::opt<unsigned> MicroBenchIterations("micro-bench-iterations",
+  cl::desc("Time the import sorting, range collapsing, top file lookup and "
+           "flush this many times on every parsed translation unit and "
+           "add the times to -stats-json"),
+  cl::init(0), cl::cat(ImportTidyCategory));
+
+static bool isMergeCommand(int argc, const char **argv) {
+  for (int I = 1; I < argc; I++) {
+    StringRef Arg = argv[I];
+    if (Arg.startswith("-merge") || Arg.startswith("--merge"))
+      return true;
+  }
+  return false;
+}
+
+static bool parseShard(StringRef Value, unsigned &Index, unsigned &Count) {
+  auto Parts = Value.split('/');
+  return !Parts.first.getAsInteger(10, Index) &&
+         !Parts.second.getAsInteger(10, Count) &&
+         Count > 0 && Index < Count;
+}
+
+static bool openGraphWriter(GraphWriter &Writer) {
+  GraphWriter::Format Format;
+  if (EmitGraph == "json")
+    Format = GraphWriter::Format::JSON;
+  else if (EmitGraph == "dot")
+    Format = GraphWriter::Format::DOT;
+  else {
+    llvm::errs() << "-emit-graph takes json or dot.\n";
+    return false;
+  }
+
+  std::string Path = GraphOutput.empty() ? "import-graph." + EmitGraph : GraphOutput;
+  if (!Writer.open(Path, Format)) {
+    llvm::errs() << "Couldn't write " << Path << ".\n";
+    return false;
+  }
+  return true;
+}
+
+static int mergeShards() {
+  // merging only replays results, nothing is compiled
+  FixedCompilationDatabase Compilations(".", std::vector<std::string>());
+  ImportRunner Runner(Compilations, std::vector<std::string>());
+  MatchOptions Options;
+  Options.IncludeGraph = IncludeGraph;
+  Runner.setMatchOptions(Options);
+  Runner.setSaveFiles(ExportFixes.empty());
+  Runner.setExportFixes(ExportFixes);
+  Runner.setQuiet(Quiet);
+  GraphWriter Edges;
+  if (!EmitGraph.empty()) {
+    if (!openGraphWriter(Edges))
+      return 1;
+    Runner.setGraphWriter(&Edges);
+  }
+  // a merge is what writes the files of a sharded run, a missing or
+  // failed shard has to fail it
+  int Status = Runner.mergeShards(Merge, llvm::outs());
+  if (Status == 0 && !Runner.saveReplacements())
+    Status = 1;
+  if (!EmitGraph.empty() && !Edges.close())
+    llvm::errs() << "Couldn't write the import graph.\n";
+  Runner.printLibraryCounts(llvm::outs());
+  Runner.printImportGraph(llvm::outs());
+  return Status;
+}
 
 int main(int argc, const char **argv) {
   sys::PrintStackTraceOnErrorSignal();
+
+  // a merge has no sources, which CommonOptionsParser requires
+  if (isMergeCommand(argc, argv)) {
+    cl::ParseCommandLineOptions(argc, argv);
+    return mergeShards();
+  }
+
   CommonOptionsParser OptionsParser(argc, argv, ImportTidyCategory);
-  RefactoringTool Tool(OptionsParser.getCompilations(),
-                       OptionsParser.getSourcePathList());
-  MatchFinder Finder;
-  ImportMatcher IM(Tool.getReplacements());
-  Tool.runAndSave(IM.getActionFactory(Finder).get());
-  IM.printLibraryCounts(llvm::outs());
-
-  return 0;
+  ImportRunner Runner(OptionsParser.getCompilations(),
+                      OptionsParser.getSourcePathList());
+  Runner.setJobs(Jobs ? Jobs : std::thread::hardware_concurrency());
+
+  if (!Shard.empty() || !ShardOutput.empty()) {
+    unsigned Index = 0, Count = 1;
+    if (ShardOutput.empty() ||
+        (!Shard.empty() && !parseShard(Shard, Index, Count))) {
+      llvm::errs() << "-shard takes i/n with i < n and needs -shard-output.\n";
+      return 1;
+    }
+    Runner.setShard(Index, Count);
+  }
+
+  MatchOptions Options;
+  Options.UseMatchers = UseMatchers;
+  Options.PrintMatchTime = MatchTime;
+  Options.SkipHeaderBodies = SkipHeaderBodies;
+  Options.VerifySkippedBodies = VerifySkippedBodies;
+  Options.CollectStats = !StatsJSON.empty() || !Trace.empty();
+  Options.ModuleImports = ModuleImports;
+  Options.IncludeGraph = IncludeGraph;
+  Options.ImportEdges = !EmitGraph.empty();
+  Options.MainFilesOnly = !Serve.empty();
+  Options.MicroBenchIterations = MicroBenchIterations;
+  if (MicroBenchIterations && StatsJSON.empty()) {
+    llvm::errs() << "-micro-bench-iterations needs -stats-json.\n";
+    return 1;
+  }
+  Runner.setMatchOptions(Options);
+  Runner.setPrecompileImports(PrecompileImports);
+  Runner.setCountIncludingUnits(ReportPrefix || !ReportPrefixHeader.empty());
+  Runner.setModuleCachePath(ModuleCachePath);
+  if (!CacheDir.empty())
+    Runner.setCacheDirectory(CacheDir);
+  if (Prefilter && CacheDir.empty()) {
+    llvm::errs() << "-prefilter needs -cache-dir.\n";
+    return 1;
+  }
+  Runner.setPrefilter(Prefilter);
+  Runner.setQuiet(Quiet);
+
+  std::vector<std::string> Affected;
+  if (!ChangedSince.empty()) {
+    std::vector<std::string> Changed;
+    if (!Runner.hasIncludeIndex() || !changedFiles(ChangedSince, Changed)) {
+      llvm::errs() << "-changed-since needs -cache-dir and a git revision.\n";
+      return 1;
+    }
+    Affected = Runner.affectedSources(Changed);
+    llvm::outs() << Affected.size() << " of "
+                 << OptionsParser.getSourcePathList().size()
+                 << " sources are affected by changes since " << ChangedSince << "\n";
+    if (Affected.empty())
+      return 0;
+    Runner.setSourcePaths(Affected);
+  }
+
+  // a shard keeps the edges for the merge to write
+  GraphWriter Edges;
+  if (!EmitGraph.empty() && ShardOutput.empty() && !Check) {
+    if (!openGraphWriter(Edges))
+      return 1;
+    Runner.setGraphWriter(&Edges);
+  }
+
+  if (!Serve.empty()) {
+    ImportServer Server(Runner);
+    if (!Server.listen(Serve))
+      return 1;
+    return Server.serve();
+  }
+
+  // a check only reports, it writes nothing
+  if (Check) {
+    Runner.setSaveFiles(false);
+    Runner.setQuiet(true);
+    Runner.setCheckLimit(CheckLimit);
+    int Status = Runner.run(llvm::outs());
+    Runner.printCheckSummary(llvm::outs());
+    return Status != 0 || !Runner.getUntidyFiles().empty() ? 1 : 0;
+  }
+
+  Runner.setSaveFiles(ShardOutput.empty() && ExportFixes.empty());
+  if (ShardOutput.empty())
+    Runner.setExportFixes(ExportFixes);
+  int Status = Runner.run(llvm::outs());
+  if (!ShardOutput.empty()) {
+    if (!Runner.writeShard(ShardOutput)) {
+      llvm::errs() << "Couldn't write " << ShardOutput << ".\n";
+      return 1;
+    }
+  } else if (Status == 0 && !Runner.saveReplacements()) {
+    Status = 1;
+  }
+  if (!EmitGraph.empty() && ShardOutput.empty() && !Edges.close())
+    llvm::errs() << "Couldn't write the import graph.\n";
+  Runner.printLibraryCounts(llvm::outs());
+  Runner.printImportGraph(llvm::outs());
+  if (ReportPrefix || !ReportPrefixHeader.empty()) {
+    PrefixReport Report(OptionsParser.getCompilations(),
+                        OptionsParser.getSourcePathList());
+    Report.measure(Runner.getLibraryCounts(), Runner.getFileCounts(),
+                   Runner.getIncludingUnits());
+    Report.print(llvm::outs());
+    if (!ReportPrefixHeader.empty() && !Report.writePrefixHeader(ReportPrefixHeader))
+      llvm::errs() << "Couldn't write " << ReportPrefixHeader << ".\n";
+  }
+  if (CacheStats)
+    Runner.printCacheStats(llvm::outs());
+
+  if (auto *Stats = Runner.getStats()) {
+    if (!StatsJSON.empty() && !Stats->writeJSON(StatsJSON))
+      llvm::errs() << "Couldn't write " << StatsJSON << ".\n";
+    if (!Trace.empty() && !Stats->writeTrace(Trace))
+      llvm::errs() << "Couldn't write " << Trace << ".\n";
+  }
+
+  return Status;
 }
@@ -0,0 +1,141 @@
+#include "ImportVisitor.h"
+#include "ImportMatcher.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclObjC.h"
+#include "clang/AST/ExprObjC.h"
+
+using namespace clang;
+using namespace import_tidy;
+
+namespace {
+
+  template <typename T>
+  static bool isImplementationInMainFile(const T *Node, const SourceManager &SM) {
+    if (auto *ImpDecl = Node->getImplementation())
+      return SM.isInMainFile(SM.getExpansionLoc(ImpDecl->getLocStart()));
+    else
+      return false;
+  }
+
+} // end anonymous namespace
+
+namespace import_tidy {
+
+#pragma mark - ImportVisitor
+
+  void ImportVisitor::traverseTranslationUnit(ASTContext &Context) {
+    // only declarations parsed from the main file or project headers can
+    // match, so neither deserialize nor visit anything from the SDK
+    for (auto *D : Context.getTranslationUnitDecl()->noload_decls()) {
+      if (Matcher.isInProjectFile(D->getLocation(), SM))
+        TraverseDecl(D);
+    }
+  }
+
+  bool ImportVisitor::isExpansionInMainFile(SourceLocation Loc) const {
+    return SM.isInMainFile(SM.getExpansionLoc(Loc));
+  }
+
+  bool ImportVisitor::isNotInSystemHeader(SourceLocation Loc) const {
+    return Loc.isValid() && !SM.isInSystemHeader(Loc);
+  }
+
+  bool ImportVisitor::VisitCallExpr(CallExpr *E) {
+    if (isExpansionInMainFile(E->getLocStart()))
+      Matcher.CallCallback.handle(E, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitCStyleCastExpr(CStyleCastExpr *E) {
+    if (isExpansionInMainFile(E->getLocStart()))
+      Matcher.CastCallback.handle(E, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitDeclRefExpr(DeclRefExpr *E) {
+    if (isNotInSystemHeader(E->getLocation()))
+      Matcher.DeclRefCallback.handle(E, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitFunctionDecl(FunctionDecl *D) {
+    if (D->isThisDeclarationADefinition() && D->hasPrototype() &&
+        isNotInSystemHeader(D->getLocation()))
+      Matcher.FuncDeclCallback.handle(D, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitImportDecl(ImportDecl *D) {
+    if (isNotInSystemHeader(D->getLocation()))
+      Matcher.StripCallback.handle(D, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitObjCCategoryDecl(ObjCCategoryDecl *D) {
+    if (isImplementationInMainFile(D, SM))
+      Matcher.CategoryCallback.handle(D, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitObjCInterfaceDecl(ObjCInterfaceDecl *D) {
+    if (D->isThisDeclarationADefinition()) {
+      if (isImplementationInMainFile(D, SM))
+        Matcher.InterfaceCallback.handle(D, SM);
+    } else if (isNotInSystemHeader(D->getLocation())) {
+      // forward declarations are stripped and regenerated
+      Matcher.StripCallback.handle(D, SM);
+    }
+    return true;
+  }
+
+  bool ImportVisitor::VisitObjCMessageExpr(ObjCMessageExpr *E) {
+    if (isExpansionInMainFile(E->getLocStart()))
+      Matcher.MsgCallback.handle(E, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitObjCMethodDecl(ObjCMethodDecl *D) {
+    auto *Container = dyn_cast<ObjCContainerDecl>(
+                        Decl::castFromDeclContext(D->getLexicalDeclContext()));
+    if (Container && isNotInSystemHeader(Container->getLocation()))
+      Matcher.MtdCallback.handle(D, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitObjCProtocolDecl(ObjCProtocolDecl *D) {
+    if (isNotInSystemHeader(D->getLocation()))
+      Matcher.ProtoCallback.handle(D, SM);
+    return true;
+  }
+
+  bool ImportVisitor::VisitObjCProtocolExpr(ObjCProtocolExpr *E) {
+    if (isExpansionInMainFile(E->getLocStart()))
+      Matcher.ProtoCallback.handle(E, SM);
+    return true;
+  }
+
+#pragma mark - ImportASTConsumer
+
+  void ImportASTConsumer::Initialize(ASTContext &Ctx) {
+    Context = &Ctx;
+    Matcher.setModulesEnabled(Ctx.getLangOpts().Modules);
+    if (FinderConsumer)
+      FinderConsumer->Initialize(Ctx);
+  }
+
+  void ImportASTConsumer::HandleTranslationUnit(ASTContext &Ctx) {
+    auto Start = std::chrono::steady_clock::now();
+
+    if (FinderConsumer)
+      FinderConsumer->HandleTranslationUnit(Ctx);
+    else
+      ImportVisitor(Matcher, Ctx.getSourceManager()).traverseTranslationUnit(Ctx);
+
+    Matcher.recordTimes(Created, Start, std::chrono::steady_clock::now());
+  }
+
+  bool ImportASTConsumer::shouldSkipFunctionBody(Decl *D) {
+    return Context && Matcher.shouldSkipFunctionBody(D, Context->getSourceManager());
+  }
+
+} // end namespace import_tidy
@@ -0,0 +1,64 @@
+#ifndef __LLVM__ImportVisitor__
+#define __LLVM__ImportVisitor__
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include <chrono>
+#include <memory>
+
+namespace import_tidy {
+  class ImportMatcher;
+
+  // Makes the same callbacks as the matchers registered in
+  // ImportMatcher::getActionFactory in a single traversal. Only top level
+  // declarations from the main file and the project headers seen by the
+  // preprocessor are traversed, everything the SDK declares is skipped
+  // as a whole instead of testing every node below it.
+  class ImportVisitor : public clang::RecursiveASTVisitor<ImportVisitor> {
+  public:
+    ImportVisitor(ImportMatcher &Matcher, const clang::SourceManager &SM) :
+      Matcher(Matcher), SM(SM) {};
+
+    void traverseTranslationUnit(clang::ASTContext&);
+    bool shouldVisitTemplateInstantiations() const { return true; }
+    bool shouldVisitImplicitCode() const { return true; }
+
+    bool VisitCallExpr(clang::CallExpr*);
+    bool VisitCStyleCastExpr(clang::CStyleCastExpr*);
+    bool VisitDeclRefExpr(clang::DeclRefExpr*);
+    bool VisitFunctionDecl(clang::FunctionDecl*);
+    bool VisitImportDecl(clang::ImportDecl*);
+    bool VisitObjCCategoryDecl(clang::ObjCCategoryDecl*);
+    bool VisitObjCInterfaceDecl(clang::ObjCInterfaceDecl*);
+    bool VisitObjCMessageExpr(clang::ObjCMessageExpr*);
+    bool VisitObjCMethodDecl(clang::ObjCMethodDecl*);
+    bool VisitObjCProtocolDecl(clang::ObjCProtocolDecl*);
+    bool VisitObjCProtocolExpr(clang::ObjCProtocolExpr*);
+  private:
+    bool isExpansionInMainFile(clang::SourceLocation) const;
+    bool isNotInSystemHeader(clang::SourceLocation) const;
+    ImportMatcher &Matcher;
+    const clang::SourceManager &SM;
+  };
+
+  // Runs either the visitor or the MatchFinder consumer over a translation
+  // unit and reports how long the parsing and matching took.
+  class ImportASTConsumer : public clang::ASTConsumer {
+  public:
+    ImportASTConsumer(ImportMatcher &Matcher,
+                      std::unique_ptr<clang::ASTConsumer> FinderConsumer) :
+      Matcher(Matcher), FinderConsumer(std::move(FinderConsumer)),
+      Context(nullptr), Created(std::chrono::steady_clock::now()) {};
+
+    void Initialize(clang::ASTContext&) override;
+    void HandleTranslationUnit(clang::ASTContext&) override;
+    bool shouldSkipFunctionBody(clang::Decl*) override;
+  private:
+    ImportMatcher &Matcher;
+    std::unique_ptr<clang::ASTConsumer> FinderConsumer;
+    clang::ASTContext *Context;
+    std::chrono::steady_clock::time_point Created;
+  };
+}
+
+#endif /* defined(__LLVM__ImportVisitor__) */
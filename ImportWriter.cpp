@@ -0,0 +1,139 @@
+#include "ImportWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <climits>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace clang::tooling;
+using namespace llvm;
+
+namespace import_tidy {
+
+#pragma mark - FileWriter
+
+  void FileWriter::start() {
+    finish(/*Commit=*/false);
+    Stopping = false;
+    Written = 0;
+    Failed = 0;
+    Thread = std::thread([this] { runWriter(); });
+  }
+
+  void FileWriter::write(StringRef Path, std::string Content) {
+    {
+      std::lock_guard<std::mutex> Lock(QueueMutex);
+      Queue.push_back(std::make_pair(Path.str(), std::move(Content)));
+    }
+    QueueReady.notify_one();
+  }
+
+  bool FileWriter::finish(bool Commit) {
+    if (Thread.joinable()) {
+      {
+        std::lock_guard<std::mutex> Lock(QueueMutex);
+        Stopping = true;
+      }
+      QueueReady.notify_one();
+      Thread.join();
+    }
+
+    // a file that couldn't be written could be a header the others rely
+    // on, write all of them or none
+    Commit &= Failed == 0;
+    for (auto &File : Staged) {
+      if (Commit && !sys::fs::rename(File.TempPath, File.Target)) {
+        Written++;
+        continue;
+      }
+      if (Commit) {
+        errs() << "Couldn't write " << File.Target << ".\n";
+        Failed++;
+      }
+      sys::fs::remove(File.TempPath);
+    }
+    Staged.clear();
+    return Failed == 0;
+  }
+
+  void FileWriter::runWriter() {
+    while (true) {
+      std::unique_lock<std::mutex> Lock(QueueMutex);
+      QueueReady.wait(Lock, [this] { return Stopping || !Queue.empty(); });
+      if (Queue.empty())
+        return;
+      auto File = std::move(Queue.front());
+      Queue.pop_front();
+      Lock.unlock();
+
+      StagedFile Temp;
+      if (writeTemporaryFile(File.first, File.second, Temp.TempPath, Temp.Target)) {
+        Lock.lock();
+        Staged.push_back(std::move(Temp));
+      } else {
+        errs() << "Couldn't write " << File.first << ".\n";
+        Failed++;
+      }
+    }
+  }
+
+#pragma mark - Helpers
+
+  bool applyReplacements(StringRef Path, const std::vector<Replacement> &Replaces,
+                         std::string &Content, bool &Changed) {
+    auto Buffer = MemoryBuffer::getFile(Path);
+    if (!Buffer)
+      return false;
+
+    StringRef Original = (*Buffer)->getBuffer();
+    Replacements Set(Replaces.begin(), Replaces.end());
+    Content = applyAllReplacements(Original, Set);
+
+    // an empty result is how a replacement that doesn't apply is reported
+    if (Content.empty() && !Original.empty())
+      return false;
+    Changed = Content != Original;
+    return true;
+  }
+
+  bool writeTemporaryFile(StringRef Path, StringRef Content,
+                          std::string &TempFile, std::string &Target) {
+    // renaming over a symlink would replace the link, write the file it
+    // points to instead
+    Target = Path;
+    char Resolved[PATH_MAX];
+    if (realpath(Target.c_str(), Resolved))
+      Target = Resolved;
+
+    int FD;
+    SmallString<256> TempPath;
+    if (sys::fs::createUniqueFile(Target + "-%%%%%%.tmp", FD, TempPath))
+      return false;
+
+    // the temporary file is created 0666 less the umask, keep the mode of
+    // the file it replaces
+    struct stat Original;
+    if (::stat(Target.c_str(), &Original) == 0 &&
+        ::fchmod(FD, Original.st_mode & 07777) != 0) {
+      ::close(FD);
+      sys::fs::remove(TempPath.str());
+      return false;
+    }
+
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      OS << Content;
+      OS.close();
+      if (OS.has_error()) {
+        OS.clear_error();
+        sys::fs::remove(TempPath.str());
+        return false;
+      }
+    }
+
+    TempFile = TempPath.str();
+    return true;
+  }
+
+} // end namespace import_tidy
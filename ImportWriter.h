@@ -0,0 +1,63 @@
+#ifndef __LLVM__ImportWriter__
+#define __LLVM__ImportWriter__
+
+#include "clang/Tooling/Refactoring.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace import_tidy {
+
+  // Writes tidied files on a thread of its own while the next translation
+  // units are parsed. Each file is written to a temporary file next to it,
+  // and only renamed over it once the whole run succeeded, so neither a
+  // build nor a failed run ever sees part of the output.
+  class FileWriter {
+  public:
+    FileWriter() : Stopping(false), Written(0), Failed(0) {};
+    ~FileWriter() { finish(/*Commit=*/false); }
+
+    void start();
+    void write(llvm::StringRef Path, std::string Content);
+
+    // waits for every queued file, then renames them all into place, or
+    // removes them all if any couldn't be written or Commit is false
+    bool finish(bool Commit = true);
+    unsigned getWritten() const { return Written; }
+  private:
+    // a temporary file and the file it replaces
+    struct StagedFile {
+      std::string TempPath;
+      std::string Target;
+    };
+    void runWriter();
+    std::thread Thread;
+    std::mutex QueueMutex;
+    std::condition_variable QueueReady;
+    std::deque<std::pair<std::string, std::string>> Queue;
+    std::vector<StagedFile> Staged;
+    bool Stopping;
+    std::atomic<unsigned> Written;
+    std::atomic<unsigned> Failed;
+  };
+
+  // the content of the file at Path with Replacements applied and whether
+  // that is any different, false if it couldn't be read or they don't apply
+  bool applyReplacements(llvm::StringRef Path,
+                         const std::vector<clang::tooling::Replacement>&,
+                         std::string &Content, bool &Changed);
+
+  // Content written to a temporary file next to Path, or next to the file
+  // a symlink at Path points to, with the mode of the file it replaces.
+  // Target is the file to rename it over
+  bool writeTemporaryFile(llvm::StringRef Path, llvm::StringRef Content,
+                          std::string &TempPath, std::string &Target);
+}
+
+#endif /* defined(__LLVM__ImportWriter__) */
@@ -0,0 +1,7 @@
+#import <FakeKit/FakeKit.h>
+@class Item;
+
+@interface Loader : FKObject
+- (void)loadWithCompletion:(FKCompletion)completion;
+- (void)loadItems:(void (^)(Item *item, FKInteger index))handler;
+@end
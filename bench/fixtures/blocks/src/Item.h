@@ -0,0 +1,4 @@
+#import <FakeKit/FakeKit.h>
+
+@interface Item : FKObject
+@end
@@ -0,0 +1,12 @@
+#import <FakeKit/FakeKit.h>
+#import "Item.h"
+#import "Loader.h"
+
+@implementation Loader
+- (void)loadWithCompletion:(FKCompletion)completion {
+  completion(0);
+}
+- (void)loadItems:(void (^)(Item *item, FKInteger index))handler {
+  handler([[Item alloc] init], 1);
+}
+@end
@@ -0,0 +1,5 @@
+#import "Widget.h"
+
+@interface Widget (Spinning)
+- (void)spinTwice;
+@end
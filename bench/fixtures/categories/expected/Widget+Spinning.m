@@ -0,0 +1,8 @@
+#import "Widget+Spinning.h"
+
+@implementation Widget (Spinning)
+- (void)spinTwice {
+  [self spin];
+  [self spin];
+}
+@end
@@ -0,0 +1,5 @@
+#import <FakeKit/FakeKit.h>
+
+@interface Widget : FKObject
+- (void)spin;
+@end
@@ -0,0 +1,6 @@
+#import "Widget.h"
+
+@implementation Widget
+- (void)spin {
+}
+@end
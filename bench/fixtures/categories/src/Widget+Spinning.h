@@ -0,0 +1,6 @@
+#import <FakeKit/FakeKit.h>
+#import "Widget.h"
+
+@interface Widget (Spinning)
+- (void)spinTwice;
+@end
@@ -0,0 +1,10 @@
+#import <FakeKit/FakeKit.h>
+#import "Widget.h"
+#import "Widget+Spinning.h"
+
+@implementation Widget (Spinning)
+- (void)spinTwice {
+  [self spin];
+  [self spin];
+}
+@end
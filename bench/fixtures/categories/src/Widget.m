@@ -0,0 +1,7 @@
+#import "Widget+Spinning.h"
+#import "Widget.h"
+
+@implementation Widget
+- (void)spin {
+}
+@end
@@ -0,0 +1,6 @@
+#import <FakeKit/FakeKit.h>
+#import <FakeUI/FakeUI.h>
+
+@interface Panel : FKView
+- (FUIButton *)closeButton;
+@end
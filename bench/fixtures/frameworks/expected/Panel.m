@@ -0,0 +1,10 @@
+#import "Panel.h"
+
+@implementation Panel
+- (FUIButton *)closeButton {
+  return 0;
+}
+- (void)draw {
+  [self setNeedsDisplay];
+}
+@end
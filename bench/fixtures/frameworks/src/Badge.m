@@ -0,0 +1,5 @@
+#import <FakeKit/FKView.h>
+
+void BadgeDraw(FKView *view) {
+  [view setNeedsDisplay];
+}
@@ -0,0 +1,6 @@
+#import <FakeKit/FKView.h>
+#import <FakeUI/FakeUI.h>
+
+@interface Panel : FKView
+- (FUIButton *)closeButton;
+@end
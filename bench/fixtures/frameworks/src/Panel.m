@@ -0,0 +1,11 @@
+#import <FakeUI/FakeUI.h>
+#import "Panel.h"
+
+@implementation Panel
+- (FUIButton *)closeButton {
+  return 0;
+}
+- (void)draw {
+  [self setNeedsDisplay];
+}
+@end
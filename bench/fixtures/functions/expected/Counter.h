@@ -0,0 +1,5 @@
+#import <FakeKit/FakeKit.h>
+
+@interface Counter : FKObject
+- (FKInteger)count;
+@end
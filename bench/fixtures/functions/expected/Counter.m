@@ -0,0 +1,8 @@
+#import "Counter.h"
+#import "MathUtils.h"
+
+@implementation Counter
+- (FKInteger)count {
+  return MUAdd(FKMakeInteger(1), 2);
+}
+@end
@@ -0,0 +1,5 @@
+#import <FakeKit/FakeKit.h>
+
+typedef FKInteger MUValue;
+
+MUValue MUAdd(MUValue a, MUValue b);
@@ -0,0 +1,5 @@
+#import "MathUtils.h"
+
+MUValue MUAdd(MUValue a, MUValue b) {
+  return a + b;
+}
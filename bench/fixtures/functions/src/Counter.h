@@ -0,0 +1,6 @@
+#import <FakeKit/FakeKit.h>
+#import "MathUtils.h"
+
+@interface Counter : FKObject
+- (FKInteger)count;
+@end
@@ -0,0 +1,9 @@
+#import <FakeKit/FakeKit.h>
+#import "Counter.h"
+#import "MathUtils.h"
+
+@implementation Counter
+- (FKInteger)count {
+  return MUAdd(FKMakeInteger(1), 2);
+}
+@end
@@ -0,0 +1,6 @@
+#import <FakeKit/FakeKit.h>
+#import "MathUtils.h"
+
+MUValue MUAdd(MUValue a, MUValue b) {
+  return a + b;
+}
@@ -0,0 +1,5 @@
+@import FakeKit;
+
+@interface Gallery : FKView
+- (void)show;
+@end
@@ -0,0 +1,9 @@
+@import FakeUI;
+#import "Gallery.h"
+
+@implementation Gallery
+- (void)show {
+  FUIButton *button = [FUIButton button];
+  [button press];
+}
+@end
@@ -0,0 +1,7 @@
+#import <FakeKit/FakeKit.h>
+#import "Drawable.h"
+@protocol Canvas;
+
+@interface Shape : FKObject <Drawable>
+- (void)drawOnCanvas:(id<Canvas>)canvas;
+@end
@@ -0,0 +1,14 @@
+#import "Canvas.h"
+#import "Shape.h"
+
+@implementation Shape
+- (void)draw {
+}
+- (void)drawTwice {
+  [self draw];
+  [self draw];
+}
+- (void)drawOnCanvas:(id<Canvas>)canvas {
+  [canvas fill];
+}
+@end
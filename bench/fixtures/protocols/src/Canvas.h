@@ -0,0 +1,5 @@
+#import <FakeKit/FakeKit.h>
+
+@protocol Canvas
+- (void)fill;
+@end
@@ -0,0 +1,5 @@
+#import <FakeKit/FakeKit.h>
+
+@protocol Drawable <FKDrawing>
+- (void)drawTwice;
+@end
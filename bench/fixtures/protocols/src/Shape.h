@@ -0,0 +1,7 @@
+#import <FakeKit/FakeKit.h>
+#import "Drawable.h"
+#import "Canvas.h"
+
+@interface Shape : FKObject <Drawable>
+- (void)drawOnCanvas:(id<Canvas>)canvas;
+@end
@@ -0,0 +1,15 @@
+#import <FakeKit/FakeKit.h>
+#import "Shape.h"
+#import "Canvas.h"
+
+@implementation Shape
+- (void)draw {
+}
+- (void)drawTwice {
+  [self draw];
+  [self draw];
+}
+- (void)drawOnCanvas:(id<Canvas>)canvas {
+  [canvas fill];
+}
+@end
@@ -0,0 +1,3 @@
+#import <FakeKit/FKTypes.h>
+
+FKInteger FKMakeInteger(int value);
@@ -0,0 +1,5 @@
+__attribute__((objc_root_class))
+@interface FKObject
++ (instancetype)alloc;
+- (instancetype)init;
+@end
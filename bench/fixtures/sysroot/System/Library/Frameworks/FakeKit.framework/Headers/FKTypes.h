@@ -0,0 +1,2 @@
+typedef int FKInteger;
+typedef void (^FKCompletion)(FKInteger result);
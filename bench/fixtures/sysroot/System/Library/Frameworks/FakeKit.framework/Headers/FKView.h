@@ -0,0 +1,9 @@
+#import <FakeKit/FKObject.h>
+
+@protocol FKDrawing
+- (void)draw;
+@end
+
+@interface FKView : FKObject <FKDrawing>
+- (void)setNeedsDisplay;
+@end
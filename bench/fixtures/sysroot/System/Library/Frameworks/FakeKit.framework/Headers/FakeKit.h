@@ -0,0 +1,4 @@
+#import <FakeKit/FKObject.h>
+#import <FakeKit/FKTypes.h>
+#import <FakeKit/FKView.h>
+#import <FakeKit/FKFunctions.h>
@@ -0,0 +1,6 @@
+#import <FakeKit/FakeKit.h>
+
+@interface FUIButton : FKView
++ (FUIButton *)button;
+- (void)press;
+@end
@@ -0,0 +1 @@
+#import <FakeUI/FUIButton.h>
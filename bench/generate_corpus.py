@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Generates a synthetic Objective-C project to benchmark import-tidy with.
+
+The project has a fake sysroot with a configurable number of frameworks, and
+a tree of classes that each come with a protocol chain, a stack of categories
+and an implementation importing a sample of the other class headers. A
+compile_commands.json next to the sources makes it ready for `import-tidy -p`.
+"""
+
+import argparse
+import json
+import os
+import random
+
+try:
+    from shlex import quote
+except ImportError:
+    from pipes import quote
+
+
+def write(path, text):
+    directory = os.path.dirname(path)
+    if not os.path.isdir(directory):
+        os.makedirs(directory)
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def framework_dir(sysroot, k):
+    return os.path.join(sysroot, 'System', 'Library', 'Frameworks',
+                        'FakeKit%d.framework' % k, 'Headers')
+
+
+def generate_frameworks(sysroot, frameworks, headers):
+    for k in range(frameworks):
+        umbrella = []
+        for h in range(headers):
+            name = 'FK%dThing%d' % (k, h)
+            lines = []
+            if k == 0 and h == 0:
+                lines += [
+                    '__attribute__((objc_root_class))',
+                    '@interface FKObject',
+                    '+ (instancetype)alloc;',
+                    '- (instancetype)init;',
+                    '@end',
+                    '',
+                ]
+            else:
+                lines += ['#import <FakeKit0/FK0Thing0.h>', '']
+            lines += [
+                '@class %s;' % name,
+                'typedef void (^FK%dBlock%d)(%s *thing);' % (k, h, name),
+                'typedef int FK%dValue%d;' % (k, h),
+                '',
+                '@protocol FK%dDelegate%d' % (k, h),
+                '- (void)thingDidChange:(%s *)thing;' % name,
+                '@end',
+                '',
+                '@interface %s : FKObject' % name,
+                '- (FK%dValue%d)value;' % (k, h),
+                '- (void)performWithBlock:(FK%dBlock%d)block;' % (k, h),
+                '- (void)setDelegate:(id<FK%dDelegate%d>)delegate;' % (k, h),
+                '@end',
+                '',
+                '%s *FK%dMake%d(int value);' % (name, k, h),
+                '',
+            ]
+            write(os.path.join(framework_dir(sysroot, k), name + '.h'),
+                  '\n'.join(lines))
+            umbrella.append('#import <FakeKit%d/%s.h>' % (k, name))
+        write(os.path.join(framework_dir(sysroot, k), 'FakeKit%d.h' % k),
+              '\n'.join(umbrella) + '\n')
+
+
+def generate_class(src, rng, i, args):
+    name = 'Class%d' % i
+    kit = rng.randrange(args.frameworks)
+    thing = 'FK%dThing%d' % (kit, rng.randrange(args.framework_headers))
+
+    # protocol chain, each protocol refining the previous one, importing
+    # the framework its methods use so the header stands on its own
+    protocols = ['Proto%d_%d' % (i, p) for p in range(args.protocol_depth)]
+    lines = ['#import <FakeKit%d/FakeKit%d.h>' % (kit, kit), '']
+    for p, proto in enumerate(protocols):
+        refines = '<%s>' % protocols[p - 1] if p else ''
+        lines += ['@protocol %s %s' % (proto, refines),
+                  '- (%s *)thingFor%s;' % (thing, proto), '@end', '']
+    write(os.path.join(src, name + 'Protocols.h'), '\n'.join(lines))
+
+    # every few classes starts a new inheritance chain
+    superclass = 'Class%d' % (i - 1) if i % 4 else 'FKObject'
+    conforms = '<%s>' % protocols[-1] if protocols else ''
+    header = ['#import <FakeKit%d/FakeKit%d.h>' % (kit, kit),
+              '#import "%sProtocols.h"' % name]
+    if i % 4:
+        header.append('#import "%s.h"' % superclass)
+    header += ['',
+               '@interface %s : %s %s' % (name, superclass, conforms),
+               '- (%s *)thing%d;' % (thing, i),
+               '- (void)update%s:(id)sender;' % name,
+               '@end', '']
+    write(os.path.join(src, name + '.h'), '\n'.join(header))
+
+    # a stack of categories, each one building on the previous
+    categories = []
+    for d in range(args.category_depth):
+        category = '%s+Cat%d' % (name, d)
+        previous = '%s+Cat%d.h' % (name, d - 1) if d else '%s.h' % name
+        write(os.path.join(src, category + '.h'), '\n'.join([
+            '#import "%s"' % previous, '',
+            '@interface %s (Cat%d)' % (name, d),
+            '- (%s *)categoryThing%d;' % (thing, d),
+            '@end', '']))
+        write(os.path.join(src, category + '.m'), '\n'.join([
+            '#import <FakeKit0/FakeKit0.h>',
+            '#import "%s.h"' % category, '',
+            '@implementation %s (Cat%d)' % (name, d),
+            '- (%s *)categoryThing%d { return FK%dMake%d(%d); }' % (
+                thing, d, kit, int(thing.rsplit('Thing', 1)[1]), d),
+            '@end', '']))
+        categories.append(category)
+
+    # the implementation uses a sample of the other classes
+    others = rng.sample(range(args.classes), min(args.fan_out, args.classes))
+    imports = ['#import <FakeKit%d/FakeKit%d.h>' % (k, k)
+               for k in range(args.frameworks)]
+    imports += ['#import "%s.h"' % name]
+    imports += ['#import "Class%d.h"' % j for j in others if j != i]
+    imports += ['#import "%s.h"' % c for c in categories]
+
+    body = []
+    for j in others:
+        if j == i:
+            continue
+        body += ['  Class%d *other%d = [[Class%d alloc] init];' % (j, j, j),
+                 '  [other%d update%s:self];' % (j, 'Class%d' % j),
+                 '  [[other%d thing%d] performWithBlock:^(id t) { (void)t; }];' % (j, j),
+                 '  (void)(id)other%d;' % j]
+    for d in range(args.category_depth):
+        body.append('  (void)[self categoryThing%d];' % d)
+    for proto in protocols:
+        body.append('  (void)@protocol(%s);' % proto)
+
+    impl = imports + ['',
+                      '@implementation %s' % name,
+                      '- (%s *)thing%d { return 0; }' % (thing, i),
+                      '- (void)update%s:(id)sender {' % name] + body + ['}']
+    for proto in protocols:
+        impl.append('- (%s *)thingFor%s { return [self thing%d]; }' % (thing, proto, i))
+    impl += ['@end', '']
+    write(os.path.join(src, name + '.m'), '\n'.join(impl))
+    return [name + '.m'] + [c + '.m' for c in categories]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('output', help='directory to write the project to')
+    parser.add_argument('--classes', type=int, default=100)
+    parser.add_argument('--category-depth', type=int, default=2)
+    parser.add_argument('--protocol-depth', type=int, default=2)
+    parser.add_argument('--fan-out', type=int, default=8,
+                        help='class headers each implementation imports')
+    parser.add_argument('--frameworks', type=int, default=4)
+    parser.add_argument('--framework-headers', type=int, default=16)
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    output = os.path.abspath(args.output)
+    sysroot = os.path.join(output, 'sysroot')
+    src = os.path.join(output, 'src')
+    generate_frameworks(sysroot, args.frameworks, args.framework_headers)
+
+    sources = []
+    for i in range(args.classes):
+        sources += generate_class(src, rng, i, args)
+
+    flags = ['clang', '-x', 'objective-c', '-fobjc-arc', '-fsyntax-only',
+             '-isysroot', sysroot,
+             '-iframework', os.path.join(sysroot, 'System', 'Library', 'Frameworks'),
+             '-I', src]
+    commands = [{'directory': src,
+                 'file': os.path.join(src, source),
+                 'command': ' '.join(quote(a) for a in flags + [source])}
+                for source in sources]
+    with open(os.path.join(output, 'compile_commands.json'), 'w') as f:
+        json.dump(commands, f, indent=2)
+
+    print('Generated %d translation units in %s' % (len(sources), output))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+"""Times import-tidy end to end on a generated corpus.
+
+Every repetition runs on a fresh copy of the corpus, since the tool rewrites
+the files it tidies. The wall time of each run is recorded together with the
+per phase totals from -stats-json: parsing, matching, resolving imports
+(which walks the include chain in topFileIncludingFile), sortedUniqueImports,
+collapsedRanges, ImportMatcher::flush and saving the files. The results are
+written as JSON, and --compare prints the change against an earlier result
+file, so two revisions can be compared.
+
+After the timed runs, one more run passes -micro-bench-iterations, which
+calls sortedUniqueImports, collapsedRanges, topFileIncludingFile and
+ImportMatcher::flush repeatedly on every parsed translation unit. Their
+calls and times go into the same results file under 'micro', without the
+parsing around them; --micro-iterations 0 skips that run.
+
+To guard against regressions, --golden diffs the files the first run
+rewrote against a directory saved earlier with --update-golden, and
+--max-wall-ms and --max-rss-kb set budgets. The script exits with a
+nonzero status when the output differs or a budget is exceeded.
+"""
+
+import argparse
+import difflib
+import filecmp
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+PHASES = ['parse', 'match', 'resolveImport', 'sortedUniqueImports',
+          'collapsedRanges', 'flush']
+CORPUS_OPTIONS = ['classes', 'category_depth', 'protocol_depth', 'fan_out',
+                  'frameworks', 'framework_headers', 'seed']
+
+
+def generate(directory, args):
+    command = [sys.executable, os.path.join(HERE, 'generate_corpus.py'), directory]
+    for option in CORPUS_OPTIONS:
+        command += ['--' + option.replace('_', '-'), str(getattr(args, option))]
+    subprocess.check_call(command, stdout=subprocess.DEVNULL)
+
+
+def sources(corpus):
+    with open(os.path.join(corpus, 'compile_commands.json')) as f:
+        return [entry['file'] for entry in json.load(f)]
+
+
+def relocate(corpus, copy):
+    # the compile commands hold absolute paths into the original corpus
+    path = os.path.join(copy, 'compile_commands.json')
+    with open(path) as f:
+        text = f.read()
+    with open(path, 'w') as f:
+        f.write(text.replace(corpus, copy))
+
+
+def run_once(tool, corpus, args, scratch, extra_args=()):
+    copy = os.path.join(scratch, 'corpus')
+    shutil.rmtree(copy, ignore_errors=True)
+    shutil.copytree(corpus, copy)
+    relocate(corpus, copy)
+
+    stats_path = os.path.join(scratch, 'stats.json')
+    command = [tool, '-p', copy, '-stats-json', stats_path,
+               '-j', str(args.jobs)] + list(extra_args) + args.tool_args + \
+              sources(copy)
+    start = time.time()
+    subprocess.check_call(command, stdout=subprocess.DEVNULL)
+    wall = time.time() - start
+
+    with open(stats_path) as f:
+        stats = json.load(f)
+    phases = dict((phase, 0.0) for phase in PHASES)
+    for entry in stats['files']:
+        for phase in PHASES:
+            phases[phase] += entry['phases'].get(phase, 0.0)
+    phases.update(stats['phases'])
+    return {'wall_ms': wall * 1000, 'phases_ms': phases,
+            'peak_rss_kb': stats['peak_rss_kb'],
+            'micro': stats.get('micro', {})}
+
+
+def run_micro(tool, corpus, args, scratch):
+    # a separate run, repeating the helpers would skew the timed ones
+    run = run_once(tool, corpus, args, scratch,
+                   ['-micro-bench-iterations', str(args.micro_iterations)])
+    return {'iterations': args.micro_iterations, 'functions': run['micro']}
+
+
+def tree_files(root):
+    files = []
+    for directory, _, names in os.walk(root):
+        for name in names:
+            path = os.path.join(directory, name)
+            files.append(os.path.relpath(path, root))
+    return sorted(files)
+
+
+def update_golden(copy, golden):
+    shutil.rmtree(golden, ignore_errors=True)
+    shutil.copytree(os.path.join(copy, 'src'), golden)
+
+
+def check_golden(copy, golden):
+    """Prints a diff for every file that differs, returns the count."""
+    src = os.path.join(copy, 'src')
+    actual, expected = tree_files(src), tree_files(golden)
+    failures = 0
+    for name in sorted(set(actual) ^ set(expected)):
+        print('%s: only in %s' % (name, 'output' if name in actual else 'golden'))
+        failures += 1
+    for name in sorted(set(actual) & set(expected)):
+        a, b = os.path.join(src, name), os.path.join(golden, name)
+        if filecmp.cmp(a, b, shallow=False):
+            continue
+        with open(b) as f:
+            before = f.readlines()
+        with open(a) as f:
+            after = f.readlines()
+        sys.stdout.writelines(difflib.unified_diff(
+            before, after, 'golden/' + name, 'output/' + name))
+        failures += 1
+    return failures
+
+
+def check_budgets(summary, args):
+    failures = []
+    if args.max_wall_ms and summary['wall_ms'] > args.max_wall_ms:
+        failures.append('wall time %.1f ms is over the budget of %.1f ms' %
+                        (summary['wall_ms'], args.max_wall_ms))
+    if args.max_rss_kb and summary['peak_rss_kb'] > args.max_rss_kb:
+        failures.append('peak memory %d kB is over the budget of %d kB' %
+                        (summary['peak_rss_kb'], args.max_rss_kb))
+    for failure in failures:
+        print(failure)
+    return len(failures)
+
+
+def median(values):
+    values = sorted(values)
+    middle = len(values) // 2
+    if len(values) % 2:
+        return values[middle]
+    return (values[middle - 1] + values[middle]) / 2.0
+
+
+def summarize(runs):
+    summary = {'wall_ms': median([r['wall_ms'] for r in runs]),
+               'peak_rss_kb': max(r['peak_rss_kb'] for r in runs),
+               'phases_ms': {}}
+    for phase in runs[0]['phases_ms']:
+        summary['phases_ms'][phase] = median([r['phases_ms'][phase] for r in runs])
+    return summary
+
+
+def revision():
+    try:
+        return subprocess.check_output(['git', 'rev-parse', 'HEAD'], cwd=HERE,
+                                       universal_newlines=True).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def compare(baseline, result):
+    def change(old, new):
+        if not old:
+            return 'n/a'
+        return '%+.1f%%' % ((new - old) * 100.0 / old)
+
+    old, new = baseline['summary'], result['summary']
+    rows = [('wall_ms', old['wall_ms'], new['wall_ms']),
+            ('peak_rss_kb', old['peak_rss_kb'], new['peak_rss_kb'])]
+    for phase in sorted(new['phases_ms']):
+        rows.append((phase, old['phases_ms'].get(phase, 0),
+                     new['phases_ms'][phase]))
+    # microseconds per call, only when both runs had a micro-benchmark
+    old_micro = baseline.get('micro', {}).get('functions', {})
+    new_micro = result.get('micro', {}).get('functions', {})
+    for name in sorted(set(old_micro) & set(new_micro)):
+        rows.append(('%s_us' % name, old_micro[name]['per_call_us'],
+                     new_micro[name]['per_call_us']))
+    for name, before, after in rows:
+        print('%-28s %12.3f %12.3f %8s' % (name, before, after,
+                                           change(before, after)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--tool', required=True, help='import-tidy binary')
+    parser.add_argument('--output', required=True,
+                        help='file to write the results to')
+    parser.add_argument('--corpus', help='existing corpus, generated if missing')
+    parser.add_argument('--repeat', type=int, default=3)
+    parser.add_argument('--jobs', type=int, default=1)
+    parser.add_argument('--compare', help='earlier results to compare against')
+    parser.add_argument('--golden', help='expected output of the tidied sources')
+    parser.add_argument('--update-golden', action='store_true',
+                        help='save the output to --golden instead of diffing')
+    parser.add_argument('--max-wall-ms', type=float,
+                        help='fail when the median wall time is higher')
+    parser.add_argument('--max-rss-kb', type=int,
+                        help='fail when the peak memory is higher')
+    parser.add_argument('--micro-iterations', type=int, default=20,
+                        help='calls of each function per translation unit in '
+                             'the micro-benchmark, 0 skips it')
+    parser.add_argument('--tool-args', nargs=argparse.REMAINDER, default=[],
+                        help='extra arguments for import-tidy, must come last')
+    parser.add_argument('--classes', type=int, default=100)
+    parser.add_argument('--category-depth', type=int, default=2)
+    parser.add_argument('--protocol-depth', type=int, default=2)
+    parser.add_argument('--fan-out', type=int, default=8)
+    parser.add_argument('--frameworks', type=int, default=4)
+    parser.add_argument('--framework-headers', type=int, default=16)
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    if args.update_golden and not args.golden:
+        parser.error('--update-golden needs --golden')
+
+    failures = 0
+    scratch = tempfile.mkdtemp(prefix='import-tidy-bench')
+    try:
+        corpus = args.corpus
+        if not corpus:
+            corpus = os.path.join(scratch, 'original')
+            generate(corpus, args)
+        corpus = os.path.abspath(corpus)
+
+        runs = []
+        for i in range(max(1, args.repeat)):
+            runs.append(run_once(os.path.abspath(args.tool), corpus, args, scratch))
+
+            # every run rewrites the same input, checking one is enough
+            if i == 0 and args.golden:
+                copy = os.path.join(scratch, 'corpus')
+                if args.update_golden:
+                    update_golden(copy, args.golden)
+                else:
+                    failures += check_golden(copy, args.golden)
+
+        micro = None
+        if args.micro_iterations > 0:
+            micro = run_micro(os.path.abspath(args.tool), corpus, args, scratch)
+    finally:
+        shutil.rmtree(scratch, ignore_errors=True)
+
+    result = {'revision': revision(),
+              'corpus': dict((o, getattr(args, o)) for o in CORPUS_OPTIONS)
+                        if not args.corpus else args.corpus,
+              'jobs': args.jobs,
+              'tool_args': args.tool_args,
+              'runs': runs,
+              'summary': summarize(runs)}
+    if micro:
+        result['micro'] = micro
+    with open(args.output, 'w') as f:
+        json.dump(result, f, indent=2, sort_keys=True)
+
+    if args.compare:
+        with open(args.compare) as f:
+            compare(json.load(f), result)
+
+    failures += check_budgets(result['summary'], args)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
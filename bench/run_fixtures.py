@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Runs import-tidy over the fixture projects and checks their output.
+
+Every directory in bench/fixtures with a fixture.json is a small project:
+src holds the files as they are before tidying and expected the same files
+as the tool should leave them. The fixtures share a fake SDK in
+bench/fixtures/sysroot. fixture.json lists the extra compile flags and tool
+arguments of the fixture, and its wall time and peak memory budgets.
+
+Each fixture runs on a fresh copy of src. The script prints a diff of every
+file that tidies differently from expected, and exits with a nonzero status
+on a diff, a failed run or a budget that is exceeded. --update rewrites the
+expected files from the output instead.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+try:
+    from shlex import quote
+except ImportError:
+    from pipes import quote
+
+from run_bench import check_golden, update_golden
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FIXTURES = os.path.join(HERE, 'fixtures')
+SYSROOT = os.path.join(FIXTURES, 'sysroot')
+
+
+def fixtures(names):
+    found = sorted(name for name in os.listdir(FIXTURES)
+                   if os.path.isfile(os.path.join(FIXTURES, name, 'fixture.json')))
+    if not names:
+        return found
+    for name in names:
+        if name not in found:
+            sys.exit('unknown fixture %s' % name)
+    return names
+
+
+def write_compile_commands(copy, flags):
+    src = os.path.join(copy, 'src')
+    sources = sorted(os.path.join(src, name) for name in os.listdir(src)
+                     if name.endswith('.m'))
+    arguments = ['clang', '-x', 'objective-c', '-fsyntax-only',
+                 '-isysroot', SYSROOT,
+                 '-iframework', os.path.join(SYSROOT, 'System', 'Library', 'Frameworks'),
+                 '-I', src] + flags
+    commands = [{'directory': src, 'file': source,
+                 'command': ' '.join(quote(a) for a in arguments + [source])}
+                for source in sources]
+    with open(os.path.join(copy, 'compile_commands.json'), 'w') as f:
+        json.dump(commands, f, indent=2)
+    return sources
+
+
+def run_fixture(tool, name, args, scratch):
+    directory = os.path.join(FIXTURES, name)
+    with open(os.path.join(directory, 'fixture.json')) as f:
+        fixture = json.load(f)
+
+    copy = os.path.join(scratch, name)
+    shutil.copytree(os.path.join(directory, 'src'), os.path.join(copy, 'src'))
+    sources = write_compile_commands(copy, fixture.get('flags', []))
+
+    stats_path = os.path.join(copy, 'stats.json')
+    command = [tool, '-p', copy, '-quiet', '-stats-json', stats_path,
+               '-module-cache-path', os.path.join(copy, 'module-cache')]
+    command += fixture.get('tool_args', []) + sources
+    start = time.time()
+    process = subprocess.Popen(command, stdout=subprocess.PIPE,
+                               stderr=subprocess.STDOUT,
+                               universal_newlines=True)
+    output = process.communicate()[0]
+    wall_ms = (time.time() - start) * 1000
+
+    failures = []
+    if process.returncode != 0:
+        sys.stdout.write(output)
+        failures.append('import-tidy exited with %d' % process.returncode)
+        return failures
+
+    with open(stats_path) as f:
+        peak_rss_kb = json.load(f)['peak_rss_kb']
+
+    expected = os.path.join(directory, 'expected')
+    if args.update:
+        update_golden(copy, expected)
+    elif check_golden(copy, expected):
+        failures.append('the output differs from expected')
+
+    if wall_ms > fixture['max_wall_ms']:
+        failures.append('wall time %.1f ms is over the budget of %.1f ms' %
+                        (wall_ms, fixture['max_wall_ms']))
+    if peak_rss_kb > fixture['max_rss_kb']:
+        failures.append('peak memory %d kB is over the budget of %d kB' %
+                        (peak_rss_kb, fixture['max_rss_kb']))
+    print('%s: %.1f ms, %d kB' % (name, wall_ms, peak_rss_kb))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--tool', required=True, help='import-tidy binary')
+    parser.add_argument('--update', action='store_true',
+                        help='rewrite the expected files from the output')
+    parser.add_argument('fixtures', nargs='*',
+                        help='the fixtures to run, all of them by default')
+    args = parser.parse_args()
+
+    failed = 0
+    scratch = tempfile.mkdtemp(prefix='import-tidy-fixtures')
+    try:
+        for name in fixtures(args.fixtures):
+            failures = run_fixture(os.path.abspath(args.tool), name, args, scratch)
+            for failure in failures:
+                print('%s: %s' % (name, failure))
+            if failures:
+                failed += 1
+    finally:
+        shutil.rmtree(scratch, ignore_errors=True)
+
+    if failed:
+        print('%d fixtures failed' % failed)
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())